@@ -0,0 +1,495 @@
+/** @file agg.c
+ *  @brief Implementation of agg.h
+ *
+ * The selected rows are split into one contiguous range per thread of the
+ * task pool. Each range is aggregated by a task into a private hash table,
+ * so no locking is needed, and the partial tables are merged in range order
+ * at the end.
+ */
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "agg.h"
+#include "csv.h"
+#include "emalloc.h"
+#include "pool.h"
+#include "sort.h"
+#include "table.h"
+
+#define AGG_INITIAL_CAPACITY 64
+
+/**
+ * @brief Converts the "--group_by" and "--agg" arguments into an aggregation query.
+ *
+ * `agg` is "COUNT" or "<SUM|AVG|MAX>:<field>", where the field is one of the
+ * "--order_by" fields (STREAMS, NO_SPOTIFY_PLAYLISTS, NO_APPLE_PLAYLISTS).
+ * Invalid arguments end the program.
+ *
+ * @param group_by "ARTIST" or "YEAR".
+ * @param agg The aggregate function and its field; NULL means "COUNT".
+ * @param query The query to populate.
+ */
+void parse_agg_query(const char *group_by, const char *agg, agg_query *query)
+{
+    if (strcmp(group_by, "ARTIST") == 0)
+    {
+        query->group_by = GROUP_ARTIST;
+    }
+    else if (strcmp(group_by, "YEAR") == 0)
+    {
+        query->group_by = GROUP_YEAR;
+    }
+    else
+    {
+        fprintf(stderr, "unknown group_by field: %s\n", group_by);
+        exit(1);
+    }
+
+    query->function = AGG_COUNT;
+    query->field = ORDER_NONE;
+    if (agg == NULL || strcmp(agg, "COUNT") == 0)
+    {
+        return;
+    }
+
+    const char *colon = strchr(agg, ':');
+    size_t len = colon != NULL ? (size_t)(colon - agg) : strlen(agg);
+    if (len == 3 && strncmp(agg, "SUM", 3) == 0)
+    {
+        query->function = AGG_SUM;
+    }
+    else if (len == 3 && strncmp(agg, "AVG", 3) == 0)
+    {
+        query->function = AGG_AVG;
+    }
+    else if (len == 3 && strncmp(agg, "MAX", 3) == 0)
+    {
+        query->function = AGG_MAX;
+    }
+    else
+    {
+        fprintf(stderr, "unknown aggregate: %s\n", agg);
+        exit(1);
+    }
+    if (colon == NULL)
+    {
+        fprintf(stderr, "aggregate %s needs a field, e.g. %.3s:STREAMS\n", agg, agg);
+        exit(1);
+    }
+    query->field = parse_order_by(colon + 1);
+}
+
+/**
+ * @brief Returns the columns an aggregation reads.
+ *
+ * @param query The aggregation.
+ * @return unsigned int The COL_* flags of the group key and the aggregated field.
+ */
+unsigned int agg_columns(const agg_query *query)
+{
+    unsigned int columns = query->group_by == GROUP_ARTIST ? COL_ARTISTS_NAME : COL_RELEASED_YEAR;
+    return columns | order_columns(query->field);
+}
+
+/**
+ * @brief Allocates an empty group table.
+ *
+ * @return agg_table* A pointer to the new table.
+ */
+agg_table *new_agg_table(void)
+{
+    agg_table *groups = (agg_table *)emalloc(sizeof(agg_table));
+    groups->capacity = AGG_INITIAL_CAPACITY;
+    groups->size = 0;
+    groups->slots = (agg_group *)emalloc(groups->capacity * sizeof(agg_group));
+    memset(groups->slots, 0, groups->capacity * sizeof(agg_group));
+    return groups;
+}
+
+/**
+ * @brief Frees a group table. The artist names it points to belong to the song table.
+ *
+ * @param groups The table to free.
+ */
+void free_agg_table(agg_table *groups)
+{
+    if (groups != NULL)
+    {
+        free(groups->slots);
+        free(groups);
+    }
+}
+
+/**
+ * @brief Hashes a string with FNV-1a.
+ */
+static unsigned int hash_string(const char *s)
+{
+    unsigned int h = 2166136261u;
+    for (; *s != '\0'; s++)
+    {
+        h = (h ^ (unsigned char)*s) * 16777619u;
+    }
+    return h;
+}
+
+/**
+ * @brief Hashes an int with a multiplicative (Fibonacci) hash.
+ */
+static unsigned int hash_int(int value)
+{
+    return (unsigned int)value * 2654435769u;
+}
+
+static agg_group *find_group(agg_table *groups, const agg_group *key);
+
+/**
+ * @brief Doubles the capacity of a group table, re-inserting every group.
+ */
+static void grow_agg_table(agg_table *groups)
+{
+    agg_group *old = groups->slots;
+    int old_capacity = groups->capacity;
+
+    groups->capacity *= 2;
+    groups->size = 0;
+    groups->slots = (agg_group *)emalloc(groups->capacity * sizeof(agg_group));
+    memset(groups->slots, 0, groups->capacity * sizeof(agg_group));
+
+    for (int i = 0; i < old_capacity; i++)
+    {
+        if (old[i].used)
+        {
+            *find_group(groups, &old[i]) = old[i];
+        }
+    }
+    free(old);
+}
+
+/**
+ * @brief Returns the slot of the group with the same key as `key`, claiming an empty
+ * slot (initialised from `key` with no rows) if the group is new.
+ */
+static agg_group *find_group(agg_table *groups, const agg_group *key)
+{
+    if (2 * (groups->size + 1) > groups->capacity)
+    {
+        grow_agg_table(groups);
+    }
+
+    unsigned int mask = groups->capacity - 1;
+    for (unsigned int i = key->hash & mask;; i = (i + 1) & mask)
+    {
+        agg_group *slot = &groups->slots[i];
+        if (!slot->used)
+        {
+            slot->used = 1;
+            slot->hash = key->hash;
+            slot->artist = key->artist;
+            slot->year = key->year;
+            slot->first_row = key->first_row;
+            slot->count = 0;
+            slot->sum = 0;
+            slot->max = 0;
+            groups->size++;
+            return slot;
+        }
+        if (slot->hash == key->hash &&
+            (key->artist != NULL ? strcmp(slot->artist, key->artist) == 0 : slot->year == key->year))
+        {
+            return slot;
+        }
+    }
+}
+
+/**
+ * @brief Adds the aggregate of `part` into the group with the same key in `groups`.
+ */
+static void merge_group(agg_table *groups, const agg_group *part)
+{
+    agg_group *group = find_group(groups, part);
+    if (group->count == 0 || part->max > group->max)
+    {
+        group->max = part->max;
+    }
+    if (part->first_row < group->first_row)
+    {
+        group->first_row = part->first_row;
+    }
+    group->count += part->count;
+    group->sum += part->sum;
+}
+
+/**
+ * @brief Returns the value of the aggregated field of a row.
+ */
+static long long field_value(const song_table *table, int row, order_field field)
+{
+    if (field == ORDER_STREAMS)
+    {
+        return table->streams[row];
+    }
+    if (field == ORDER_SPOTIFY_PLAYLISTS)
+    {
+        return table->in_spotify_playlists[row];
+    }
+    if (field == ORDER_APPLE_PLAYLISTS)
+    {
+        return table->in_apple_playlists[row];
+    }
+    return 0;
+}
+
+/**
+ * @brief An struct that holds the input and output of one aggregation task.
+ */
+typedef struct
+{
+    const song_table *table;
+    const int *rows;
+    int count;
+    const agg_query *query;
+    agg_table *groups;
+} agg_task;
+
+/**
+ * @brief Aggregates the rows of one task into its private group table.
+ */
+static void aggregate_range(void *arg)
+{
+    agg_task *task = (agg_task *)arg;
+    const song_table *table = task->table;
+    const agg_query *query = task->query;
+    agg_table *groups = new_agg_table();
+
+    for (int i = 0; i < task->count; i++)
+    {
+        int row = task->rows[i];
+        agg_group key;
+        key.first_row = row;
+        if (query->group_by == GROUP_ARTIST)
+        {
+            key.artist = table->artists_name[row];
+            key.year = 0;
+            key.hash = hash_string(key.artist);
+        }
+        else
+        {
+            key.artist = NULL;
+            key.year = table->released_year[row];
+            key.hash = hash_int(key.year);
+        }
+
+        agg_group *group = find_group(groups, &key);
+        long long value = field_value(table, row, query->field);
+        if (group->count == 0 || value > group->max)
+        {
+            group->max = value;
+        }
+        group->count++;
+        group->sum += value;
+    }
+
+    task->groups = groups;
+}
+
+/**
+ * @brief Groups the given rows and aggregates each group.
+ *
+ * With more than one thread in the task pool the rows are split into equal
+ * ranges that are aggregated concurrently into partial tables, then merged.
+ *
+ * @param table The table the rows belong to.
+ * @param rows The selected row ids.
+ * @param count The number of row ids.
+ * @param query The aggregation to compute.
+ * @return agg_table* The groups; free with free_agg_table.
+ */
+agg_table *aggregate_rows(const song_table *table, const int *rows, int count, const agg_query *query)
+{
+    int threads = pool_threads();
+    if (threads > count / 1024 + 1)
+    {
+        // ranges of a few hundred rows are not worth a thread
+        threads = count / 1024 + 1;
+    }
+
+    agg_task *tasks = (agg_task *)emalloc(threads * sizeof(agg_task));
+    for (int t = 0; t < threads; t++)
+    {
+        int lo = (int)((long long)count * t / threads);
+        int hi = (int)((long long)count * (t + 1) / threads);
+        tasks[t].table = table;
+        tasks[t].rows = rows + lo;
+        tasks[t].count = hi - lo;
+        tasks[t].query = query;
+        tasks[t].groups = NULL;
+    }
+
+    task_group group = TASK_GROUP_INIT;
+    for (int t = 0; t < threads; t++)
+    {
+        pool_submit(&group, aggregate_range, &tasks[t]);
+    }
+    pool_wait(&group);
+
+    agg_table *groups = tasks[0].groups;
+    for (int t = 1; t < threads; t++)
+    {
+        agg_table *part = tasks[t].groups;
+        for (int i = 0; i < part->capacity; i++)
+        {
+            if (part->slots[i].used)
+            {
+                merge_group(groups, &part->slots[i]);
+            }
+        }
+        free_agg_table(part);
+    }
+
+    free(tasks);
+    return groups;
+}
+
+/**
+ * @brief Returns the aggregate of a group as a double, for ordering.
+ */
+static double group_result(const agg_group *group, agg_function function)
+{
+    switch (function)
+    {
+    case AGG_COUNT:
+        return (double)group->count;
+    case AGG_SUM:
+        return (double)group->sum;
+    case AGG_AVG:
+        return (double)group->sum / group->count;
+    case AGG_MAX:
+        return (double)group->max;
+    }
+    return 0;
+}
+
+static agg_function compare_function;
+
+/**
+ * @brief qsort comparator: input order (first row) of the groups.
+ */
+static int compare_first_row(const void *a, const void *b)
+{
+    const agg_group *x = (const agg_group *)a;
+    const agg_group *y = (const agg_group *)b;
+    return (x->first_row > y->first_row) - (x->first_row < y->first_row);
+}
+
+/**
+ * @brief qsort comparator: aggregate value, then input order so ties stay stable.
+ */
+static int compare_result(const void *a, const void *b)
+{
+    double x = group_result((const agg_group *)a, compare_function);
+    double y = group_result((const agg_group *)b, compare_function);
+    if (x != y)
+    {
+        return x < y ? -1 : 1;
+    }
+    return compare_first_row(a, b);
+}
+
+/**
+ * @brief Writes the groups to "output.csv", one row per group.
+ *
+ * Groups are written in the order they first appear in the input. With
+ * "--order" they are ordered by their aggregate instead ("DES" reverses the
+ * ascending order, like for rows), and "--limit" keeps the first groups.
+ *
+ * @param groups The aggregated groups.
+ * @param query The aggregation that produced them.
+ * @param order "ASC", "DES" or NULL.
+ * @param limit The maximum number of groups to write; NULL writes them all.
+ */
+void write_groups_to_file(const agg_table *groups, const agg_query *query, const char *order, const char *limit)
+{
+    agg_group *sorted = (agg_group *)emalloc((groups->size > 0 ? groups->size : 1) * sizeof(agg_group));
+    int count = 0;
+    for (int i = 0; i < groups->capacity; i++)
+    {
+        if (groups->slots[i].used)
+        {
+            sorted[count++] = groups->slots[i];
+        }
+    }
+
+    if (order != NULL)
+    {
+        compare_function = query->function;
+        qsort(sorted, count, sizeof(agg_group), compare_result);
+        if (strcmp(order, "DES") == 0)
+        {
+            for (int i = 0, j = count - 1; i < j; i++, j--)
+            {
+                agg_group tmp = sorted[i];
+                sorted[i] = sorted[j];
+                sorted[j] = tmp;
+            }
+        }
+    }
+    else
+    {
+        qsort(sorted, count, sizeof(agg_group), compare_first_row);
+    }
+    if (limit != NULL && atoi(limit) < count)
+    {
+        count = atoi(limit) > 0 ? atoi(limit) : 0;
+    }
+
+    static const char *function_names[] = {"count", "sum", "avg", "max"};
+    static const char *field_names[] = {"streams", "in_spotify_playlists", "in_apple_playlists"};
+
+    FILE *output_file = fopen("output.csv", "w");
+    if (output_file == NULL)
+    {
+        perror("output.csv");
+        exit(1);
+    }
+    fprintf(output_file, "%s,%s", query->group_by == GROUP_ARTIST ? "artist(s)_name" : "released_year",
+            function_names[query->function]);
+    if (query->field != ORDER_NONE)
+    {
+        fprintf(output_file, "_%s", field_names[query->field]);
+    }
+    fprintf(output_file, "\n");
+
+    for (int i = 0; i < count; i++)
+    {
+        const agg_group *group = &sorted[i];
+        if (query->group_by == GROUP_ARTIST)
+        {
+            csv_write_field(output_file, group->artist);
+            putc(',', output_file);
+        }
+        else
+        {
+            fprintf(output_file, "%d,", group->year);
+        }
+
+        switch (query->function)
+        {
+        case AGG_COUNT:
+            fprintf(output_file, "%lld\n", group->count);
+            break;
+        case AGG_SUM:
+            fprintf(output_file, "%lld\n", group->sum);
+            break;
+        case AGG_AVG:
+            fprintf(output_file, "%.2f\n", (double)group->sum / group->count);
+            break;
+        case AGG_MAX:
+            fprintf(output_file, "%lld\n", group->max);
+            break;
+        }
+    }
+
+    fclose(output_file);
+    free(sorted);
+}
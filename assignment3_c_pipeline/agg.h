@@ -0,0 +1,80 @@
+/** @file agg.h
+ *  @brief Function prototypes for the GROUP BY aggregation of a song table.
+ *
+ */
+#ifndef _AGG_H_
+#define _AGG_H_
+
+#include "sort.h"
+#include "table.h"
+
+/**
+ * @brief The fields "--group_by" can name.
+ */
+typedef enum
+{
+    GROUP_ARTIST,
+    GROUP_YEAR
+} group_field;
+
+/**
+ * @brief The aggregate functions "--agg" can name.
+ */
+typedef enum
+{
+    AGG_COUNT,
+    AGG_SUM,
+    AGG_AVG,
+    AGG_MAX
+} agg_function;
+
+/**
+ * @brief An struct that describes an aggregation query, e.g. "--group_by=ARTIST --agg=SUM:STREAMS".
+ */
+typedef struct
+{
+    group_field group_by;
+    agg_function function;
+    order_field field;
+} agg_query;
+
+/**
+ * @brief An struct that holds the running aggregate of one group.
+ *
+ * A group is identified by `artist` (GROUP_ARTIST) or `year` (GROUP_YEAR);
+ * `first_row` is the first row of the group in the input.
+ */
+typedef struct
+{
+    int used;
+    unsigned int hash;
+    const char *artist;
+    int year;
+    int first_row;
+    long long count;
+    long long sum;
+    long long max;
+} agg_group;
+
+/**
+ * @brief An struct that represents an open-addressing hash table of groups.
+ */
+typedef struct
+{
+    agg_group *slots;
+    int capacity;
+    int size;
+} agg_table;
+
+/**
+ * Function protypes associated with aggregation.
+ *
+ */
+void parse_agg_query(const char *group_by, const char *agg, agg_query *query);
+unsigned int agg_columns(const agg_query *query);
+agg_table *new_agg_table(void);
+void free_agg_table(agg_table *groups);
+agg_table *aggregate_rows(const song_table *table, const int *rows, int count, const agg_query *query);
+void write_groups_to_file(const agg_table *groups, const agg_query *query, const char *order, const char *limit);
+
+#endif
@@ -0,0 +1,502 @@
+/** @file approx.c
+ *  @brief Implementation of approx.h
+ *
+ * DISTINCT estimates the number of distinct artists(s) names with a
+ * HyperLogLog sketch, one per release year with "--group_by=YEAR".
+ *
+ * TOP finds the artists(s) names with the largest total of a field (or the
+ * most rows) with a Space-Saving summary. Each total it reports is the
+ * smaller of the Space-Saving count and a Count-Min estimate, both of which
+ * never fall below the true total, and comes with the most it can exceed it.
+ *
+ * SAMPLE keeps a uniform random sample of the selected rows in a reservoir
+ * and writes it like a row query, ordered by any "--order_by" list. The
+ * sample is the same on every run.
+ *
+ * Csv files are read in chunks of APPROX_CHUNK_BYTES; other datasets are
+ * loaded one at a time. Only the rows the filter selects are summarized.
+ */
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "approx.h"
+#include "csv.h"
+#include "dataset.h"
+#include "emalloc.h"
+#include "list.h"
+#include "output.h"
+#include "reader.h"
+#include "rowfile.h"
+#include "scan.h"
+#include "sketch.h"
+#include "sort.h"
+#include "stats.h"
+#include "table.h"
+
+/**
+ * @brief Parses the "--approx" argument.
+ *
+ * Invalid arguments end the program.
+ *
+ * @param approx "DISTINCT", "TOP", "TOP:<field>" (an "--order_by" field) or "SAMPLE".
+ * @param group_by NULL, or "YEAR" to split DISTINCT by release year.
+ * @param limit The number of strings of TOP or of rows of SAMPLE; NULL for the default.
+ * @param query The query to populate.
+ */
+void parse_approx_query(const char *approx, const char *group_by, const char *limit, approx_query *query)
+{
+    query->per_year = 0;
+    query->field = ORDER_NONE;
+    if (strcmp(approx, "DISTINCT") == 0)
+    {
+        query->kind = APPROX_DISTINCT;
+    }
+    else if (strncmp(approx, "TOP", 3) == 0 && (approx[3] == '\0' || approx[3] == ':'))
+    {
+        query->kind = APPROX_TOP;
+        if (approx[3] == ':')
+        {
+            query->field = parse_order_by(approx + 4);
+        }
+    }
+    else if (strcmp(approx, "SAMPLE") == 0)
+    {
+        query->kind = APPROX_SAMPLE;
+    }
+    else
+    {
+        fprintf(stderr, "unknown approximate query: %s\n", approx);
+        exit(1);
+    }
+
+    if (group_by != NULL)
+    {
+        if (query->kind != APPROX_DISTINCT || strcmp(group_by, "YEAR") != 0)
+        {
+            fprintf(stderr, "--approx=%s cannot be grouped by %s\n", approx, group_by);
+            exit(1);
+        }
+        query->per_year = 1;
+    }
+
+    query->size = query->kind == APPROX_TOP ? APPROX_DEFAULT_TOP : APPROX_DEFAULT_SAMPLE;
+    if (limit != NULL)
+    {
+        query->size = atoi(limit) > 0 ? atoi(limit) : 0;
+    }
+}
+
+/**
+ * @brief Returns the columns an approximate query reads for every row.
+ *
+ * @param query The query.
+ * @param order_by The "--order_by" list of SAMPLE.
+ * @return unsigned int The COL_* flags; SAMPLE decodes the names only for the rows it keeps.
+ */
+unsigned int approx_columns(const approx_query *query, const order_spec *order_by)
+{
+    if (query->kind == APPROX_SAMPLE)
+    {
+        return order_spec_columns(order_by) & ~(COL_TRACK_NAME | COL_ARTISTS_NAME);
+    }
+    unsigned int columns = COL_ARTISTS_NAME | order_columns(query->field);
+    return query->per_year ? columns | COL_RELEASED_YEAR : columns;
+}
+
+/**
+ * @brief An struct that holds the summaries of a running approximate query.
+ *
+ * `sample_keys` holds the packed "--order_by" key (see row_sort_key) of each
+ * row of the sample, which is written with its `value` field.
+ */
+typedef struct
+{
+    const approx_query *query;
+    order_spec order_by;
+    order_field value;
+    hyperloglog *total;
+    hyperloglog **by_year;
+    count_min *cm;
+    space_saving *ss;
+    reservoir *sample;
+    unsigned char **sample_keys;
+    int *sample_key_lengths;
+} approx_state;
+
+/**
+ * @brief Returns the weight of a row for TOP.
+ */
+static int64_t row_weight(const song_table *table, int row, order_field field)
+{
+    if (field == ORDER_STREAMS)
+    {
+        return table->streams[row];
+    }
+    if (field == ORDER_SPOTIFY_PLAYLISTS)
+    {
+        return table->in_spotify_playlists[row];
+    }
+    if (field == ORDER_APPLE_PLAYLISTS)
+    {
+        return table->in_apple_playlists[row];
+    }
+    return 1;
+}
+
+/**
+ * @brief Adds the selected rows of a table to the summaries of a query.
+ */
+static void summarize_rows(approx_state *state, song_table *table, const int *rows, int count)
+{
+    const approx_query *query = state->query;
+    for (int i = 0; i < count; i++)
+    {
+        int r = rows[i];
+        if (query->kind == APPROX_DISTINCT)
+        {
+            hyperloglog *hll = state->total;
+            if (query->per_year)
+            {
+                int year = table->released_year[r];
+                if (year < 0 || year > APPROX_MAX_YEAR)
+                {
+                    fprintf(stderr, "released_year %d out of range\n", year);
+                    exit(1);
+                }
+                if (state->by_year[year] == NULL)
+                {
+                    state->by_year[year] = (hyperloglog *)emalloc(sizeof(hyperloglog));
+                    memset(state->by_year[year], 0, sizeof(hyperloglog));
+                }
+                hll = state->by_year[year];
+            }
+            hll_add(hll, sketch_hash(table->artists_name[r]));
+        }
+        else if (query->kind == APPROX_TOP)
+        {
+            uint64_t hash = sketch_hash(table->artists_name[r]);
+            int64_t weight = row_weight(table, r, query->field);
+            cm_add(state->cm, hash, weight);
+            ss_add(state->ss, table->artists_name[r], hash, weight);
+        }
+        else
+        {
+            int slot = reservoir_offer(state->sample);
+            if (slot >= 0)
+            {
+                song_row row;
+                table_materialize(table, COL_OUTPUT, &r, 1);
+                table_row(table, r, state->value, &row);
+                reservoir_store(state->sample, slot, &row);
+                free(state->sample_keys[slot]);
+                state->sample_keys[slot] = row_sort_key(table, r, &state->order_by, &state->sample_key_lengths[slot]);
+            }
+        }
+    }
+}
+
+/**
+ * @brief Filters a table and adds its selected rows to the summaries, then frees it.
+ */
+static void summarize_table(approx_state *state, song_table *table, const filter_expr *filter)
+{
+    double start = stats_now();
+    int count = 0;
+    int *rows = filter_table(table, filter, &count);
+    stats.rows_selected += count;
+    stats.filter_seconds += stats_now() - start;
+
+    start = stats_now();
+    summarize_rows(state, table, rows, count);
+    stats.aggregate_seconds += stats_now() - start;
+
+    free(rows);
+    free_table(table);
+}
+
+/**
+ * @brief Creates "output.csv"; a file that cannot be created ends the program.
+ *
+ * @return FILE* The file, open for writing.
+ */
+static FILE *create_output_csv(void)
+{
+    FILE *output_file = fopen("output.csv", "w");
+    if (output_file == NULL)
+    {
+        perror("output.csv");
+        exit(1);
+    }
+    return output_file;
+}
+
+/**
+ * @brief Writes the DISTINCT estimates to "output.csv", in order of year.
+ */
+static void write_distinct(const approx_state *state)
+{
+    FILE *output_file = create_output_csv();
+    if (state->query->per_year)
+    {
+        fprintf(output_file, "released_year,approx_distinct_artists\n");
+        for (int year = 0; year <= APPROX_MAX_YEAR; year++)
+        {
+            if (state->by_year[year] != NULL)
+            {
+                fprintf(output_file, "%d,%.0f\n", year, round(hll_estimate(state->by_year[year])));
+                stats.groups++;
+            }
+        }
+    }
+    else
+    {
+        fprintf(output_file, "approx_distinct_artists\n%.0f\n", round(hll_estimate(state->total)));
+        stats.groups = 1;
+    }
+    fclose(output_file);
+}
+
+/**
+ * @brief An struct that represents one result of TOP.
+ */
+typedef struct
+{
+    const char *key;
+    int64_t estimate;
+    int64_t error;
+} top_entry;
+
+/**
+ * @brief Compares TOP results: larger estimates first, then by name.
+ */
+static int compare_top(const void *a, const void *b)
+{
+    const top_entry *x = (const top_entry *)a;
+    const top_entry *y = (const top_entry *)b;
+    if (x->estimate != y->estimate)
+    {
+        return x->estimate > y->estimate ? -1 : 1;
+    }
+    return strcmp(x->key, y->key);
+}
+
+/**
+ * @brief Writes the `size` strings with the largest estimated totals to "output.csv".
+ */
+static void write_top(const approx_state *state)
+{
+    static const char *field_names[] = {"streams", "in_spotify_playlists", "in_apple_playlists"};
+    const space_saving *ss = state->ss;
+    top_entry *entries = (top_entry *)emalloc((ss->size > 0 ? ss->size : 1) * sizeof(top_entry));
+    for (int i = 0; i < ss->size; i++)
+    {
+        const ss_counter *c = &ss->heap[i];
+        int64_t estimate = cm_estimate(state->cm, c->hash);
+        if (c->count < estimate)
+        {
+            estimate = c->count;
+        }
+        entries[i].key = c->key;
+        entries[i].estimate = estimate;
+        entries[i].error = estimate - (c->count - c->error);
+    }
+    qsort(entries, ss->size, sizeof(top_entry), compare_top);
+    int count = ss->size < state->query->size ? ss->size : state->query->size;
+
+    FILE *output_file = create_output_csv();
+    if (state->query->field == ORDER_NONE)
+    {
+        fprintf(output_file, "artist(s)_name,approx_count,max_error\n");
+    }
+    else
+    {
+        fprintf(output_file, "artist(s)_name,approx_sum_%s,max_error\n", field_names[state->query->field]);
+    }
+    for (int i = 0; i < count; i++)
+    {
+        csv_write_field(output_file, entries[i].key);
+        fprintf(output_file, ",%lld,%lld\n", (long long)entries[i].estimate, (long long)entries[i].error);
+    }
+    fclose(output_file);
+    stats.groups = count;
+    free(entries);
+}
+
+static const approx_state *compare_sample_state;
+
+/**
+ * @brief Compares sampled rows by their "--order_by" keys, then by position in the input.
+ */
+static int compare_sample(const void *a, const void *b)
+{
+    int x = *(const int *)a;
+    int y = *(const int *)b;
+    int length_x = compare_sample_state->sample_key_lengths[x];
+    int length_y = compare_sample_state->sample_key_lengths[y];
+    int c = memcmp(compare_sample_state->sample_keys[x], compare_sample_state->sample_keys[y],
+                   length_x < length_y ? length_x : length_y);
+    if (c == 0)
+    {
+        c = (length_x > length_y) - (length_x < length_y);
+    }
+    if (c == 0)
+    {
+        long px = compare_sample_state->sample->positions[x];
+        long py = compare_sample_state->sample->positions[y];
+        c = (px > py) - (px < py);
+    }
+    return c;
+}
+
+/**
+ * @brief Writes the sampled rows in input order, or ordered by "--order_by".
+ *
+ * Like a row query, "DES" reverses the ascending order.
+ */
+static void write_sample(const approx_state *state, const char *order_by, const char *order, output_format format)
+{
+    const reservoir *sample = state->sample;
+    int *order_ids = (int *)emalloc((sample->size > 0 ? sample->size : 1) * sizeof(int));
+    for (int i = 0; i < sample->size; i++)
+    {
+        order_ids[i] = i;
+    }
+    compare_sample_state = state;
+    qsort(order_ids, sample->size, sizeof(int), compare_sample);
+    if (order != NULL && strcmp(order, "DES") == 0)
+    {
+        for (int i = 0, j = sample->size - 1; i < j; i++, j--)
+        {
+            int tmp = order_ids[i];
+            order_ids[i] = order_ids[j];
+            order_ids[j] = tmp;
+        }
+    }
+
+    output_writer *output = open_output(format, order_value_name(order_by));
+    for (int i = 0; i < sample->size; i++)
+    {
+        output_row(output, &sample->rows[order_ids[i]]);
+    }
+    close_output(output);
+    free(order_ids);
+}
+
+/**
+ * @brief Runs an approximate query over the datasets in one pass and writes its result.
+ *
+ * DISTINCT and TOP write "output.csv"; SAMPLE writes the rows in `format`.
+ *
+ * @param paths The datasets, each a csv file, a column file or a partitioned directory.
+ * @param count The number of datasets.
+ * @param filter The filter, or NULL.
+ * @param query The query.
+ * @param order_by The "--order_by" list SAMPLE orders by, or NULL.
+ * @param order "ASC", "DES" or NULL, for SAMPLE.
+ * @param format The format of the SAMPLE output.
+ */
+void run_approx_query(char *const *paths, int count, const filter_expr *filter, const approx_query *query,
+                      const char *order_by, const char *order, output_format format)
+{
+    approx_state state;
+    memset(&state, 0, sizeof(state));
+    state.query = query;
+    parse_order_spec(order_by, &state.order_by);
+    state.value = parse_order_by(order_value_name(order_by));
+    if (query->kind == APPROX_DISTINCT && query->per_year)
+    {
+        state.by_year = (hyperloglog **)emalloc((APPROX_MAX_YEAR + 1) * sizeof(hyperloglog *));
+        memset(state.by_year, 0, (APPROX_MAX_YEAR + 1) * sizeof(hyperloglog *));
+    }
+    else if (query->kind == APPROX_DISTINCT)
+    {
+        state.total = (hyperloglog *)emalloc(sizeof(hyperloglog));
+        memset(state.total, 0, sizeof(hyperloglog));
+    }
+    else if (query->kind == APPROX_TOP)
+    {
+        int counters = query->size * APPROX_TOP_FACTOR;
+        state.cm = (count_min *)emalloc(sizeof(count_min));
+        memset(state.cm, 0, sizeof(count_min));
+        state.ss = new_space_saving(counters > APPROX_TOP_COUNTERS ? counters : APPROX_TOP_COUNTERS);
+    }
+    else
+    {
+        state.sample = new_reservoir(query->size, APPROX_SEED);
+        int slots = query->size > 0 ? query->size : 1;
+        state.sample_keys = (unsigned char **)emalloc(slots * sizeof(unsigned char *));
+        memset(state.sample_keys, 0, slots * sizeof(unsigned char *));
+        state.sample_key_lengths = (int *)emalloc(slots * sizeof(int));
+    }
+
+    unsigned int columns = filter_columns(filter) | approx_columns(query, &state.order_by);
+    for (int i = 0; i < count; i++)
+    {
+        if (!is_csv_file(paths[i]))
+        {
+            double start = stats_now();
+            song_table *table = load_dataset(paths[i], filter, columns);
+            stats.rows_loaded += table->rows;
+            stats.load_seconds += stats_now() - start;
+            summarize_table(&state, table, filter);
+            continue;
+        }
+
+        line_reader *reader = open_reader(paths[i]);
+        while (1)
+        {
+            double start = stats_now();
+            node_t *lines = read_line_chunk(reader, APPROX_CHUNK_BYTES, NULL);
+            if (lines == NULL)
+            {
+                break;
+            }
+            song_table *table = table_from_list(lines, columns);
+            stats.rows_loaded += table->rows;
+            stats.load_seconds += stats_now() - start;
+            summarize_table(&state, table, filter);
+        }
+        close_reader(reader);
+    }
+
+    double start = stats_now();
+    if (query->kind == APPROX_DISTINCT)
+    {
+        write_distinct(&state);
+    }
+    else if (query->kind == APPROX_TOP)
+    {
+        write_top(&state);
+    }
+    else
+    {
+        write_sample(&state, order_by, order, format);
+    }
+    stats.output_seconds = stats_now() - start;
+
+    if (state.by_year != NULL)
+    {
+        for (int year = 0; year <= APPROX_MAX_YEAR; year++)
+        {
+            free(state.by_year[year]);
+        }
+        free(state.by_year);
+    }
+    free(state.total);
+    free(state.cm);
+    if (state.ss != NULL)
+    {
+        free_space_saving(state.ss);
+    }
+    if (state.sample != NULL)
+    {
+        for (int i = 0; i < query->size; i++)
+        {
+            free(state.sample_keys[i]);
+        }
+        free(state.sample_keys);
+        free(state.sample_key_lengths);
+        free_reservoir(state.sample);
+    }
+}
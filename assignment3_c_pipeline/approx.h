@@ -0,0 +1,65 @@
+/** @file approx.h
+ *  @brief Function prototypes for the approximate queries ("--approx").
+ *
+ * An approximate query reads its input once and keeps only fixed-size
+ * summaries (see sketch.h), so its memory does not grow with the input.
+ */
+#ifndef _APPROX_H_
+#define _APPROX_H_
+
+#include "output.h"
+#include "scan.h"
+#include "sort.h"
+
+/**
+ * @brief Csv input is read in chunks of about this many bytes.
+ */
+#define APPROX_CHUNK_BYTES (16 << 20)
+
+/**
+ * @brief The least number of counters of the Space-Saving summary; it keeps
+ * at least APPROX_TOP_FACTOR counters per string asked for.
+ */
+#define APPROX_TOP_COUNTERS 1024
+#define APPROX_TOP_FACTOR 32
+
+#define APPROX_DEFAULT_TOP 10
+#define APPROX_DEFAULT_SAMPLE 1000
+#define APPROX_SEED 0x9e3779b97f4a7c15ull
+#define APPROX_MAX_YEAR 9999
+
+/**
+ * @brief The queries "--approx" can name.
+ */
+typedef enum
+{
+    APPROX_DISTINCT,
+    APPROX_TOP,
+    APPROX_SAMPLE
+} approx_kind;
+
+/**
+ * @brief An struct that describes an approximate query, e.g. "--approx=TOP:STREAMS --limit=20".
+ *
+ * `per_year` splits DISTINCT by release year; `field` weighs the strings of
+ * TOP (ORDER_NONE counts rows); `size` is the number of strings of TOP or of
+ * rows of SAMPLE.
+ */
+typedef struct
+{
+    approx_kind kind;
+    int per_year;
+    order_field field;
+    int size;
+} approx_query;
+
+/**
+ * Function protypes associated with approximate queries.
+ *
+ */
+void parse_approx_query(const char *approx, const char *group_by, const char *limit, approx_query *query);
+unsigned int approx_columns(const approx_query *query, const order_spec *order_by);
+void run_approx_query(char *const *paths, int count, const filter_expr *filter, const approx_query *query,
+                      const char *order_by, const char *order, output_format format);
+
+#endif
@@ -0,0 +1,220 @@
+#!/bin/bash
+#
+# bench.sh - benchmark harness for song_analyzer.
+#
+# Usage:
+#   ./bench.sh                 build the debug, release and pgo configurations
+#                              and report the speedup of each over debug
+#   ./bench.sh BINARY...       time the given binaries on the benchmark queries
+#   ./bench.sh --train BINARY  run every query once (PGO training run)
+#   ./bench.sh --sort          compare --sort=MERGE and --sort=RADIX
+#   ./bench.sh --io [BINARY...] report the read throughput of a full scan
+#                              with a cold and a warm page cache
+#   ./bench.sh --approx        check the error of the --approx queries against
+#                              exact results on synthetic data
+#
+# A BINARY may carry extra arguments, e.g. "./song_analyzer --sort=RADIX".
+# With STAGE=<name> the time of that stage as reported by --stats (e.g.
+# STAGE=sort) is measured instead of the wall time of the whole run.
+#
+# The benchmark dataset is data.csv replicated SCALE times (default 10) into
+# bench_data.csv. Each query is run RUNS times (default 5) and the best wall
+# time is kept.
+#
+SCALE=${SCALE:-10}
+RUNS=${RUNS:-5}
+DATA=bench_data.csv
+
+QUERIES=(
+    "--filter=ARTIST --value=Dua+Lipa --order_by=STREAMS --order=ASC --limit=6"
+    "--filter=ARTIST --value=a --order_by=NO_APPLE_PLAYLISTS --order=DES"
+    "--filter=YEAR --value=2022 --order_by=NO_SPOTIFY_PLAYLISTS --order=ASC"
+    "--filter=YEAR --value=2019 --order_by=STREAMS --order=DES --limit=10"
+    "--filter=MIN_YEAR,MIN_SPOTIFY_PLAYLISTS --value=2020,1000 --order_by=STREAMS --order=DES --limit=10"
+    "--group_by=ARTIST --agg=SUM:STREAMS --order=DES --limit=10"
+)
+
+# Writes the benchmark dataset unless one of the requested scale exists.
+make_data()
+{
+    if [ -f $DATA ] && [ "$(cat $DATA.scale 2>/dev/null)" = "$SCALE" ]; then
+        return
+    fi
+    awk -v scale="$SCALE" 'NR == 1 { print; next } { rows[n++] = $0 }
+        END { for (s = 0; s < scale; s++) for (i = 0; i < n; i++) print rows[i] }' data.csv > $DATA
+    echo "$SCALE" > $DATA.scale
+}
+
+# Runs one query; a "+" in the query stands for a space inside a value.
+run_query()
+{
+    local bin=$1
+    local args=()
+    for a in $2; do
+        args+=("${a//+/ }")
+    done
+    $bin --data=$DATA "${args[@]}" > /dev/null
+}
+
+# Prints the best-of-RUNS time of a query in milliseconds.
+time_query()
+{
+    for ((r = 0; r < RUNS; r++)); do
+        if [ -n "$STAGE" ]; then
+            run_query "$1 --stats" "$2" 2>&1 | awk -v stage="$STAGE time:" 'index($0, stage) == 1 { print $3 }'
+        else
+            local start=$(date +%s%N)
+            run_query "$1" "$2"
+            echo "$start $(date +%s%N)" | awk '{ printf "%.3f\n", ($2 - $1) / 1e6 }'
+        fi
+    done | sort -g | head -1
+}
+
+# Times every binary on every query and prints a table of milliseconds,
+# followed by the speedup of each binary over the first one.
+compare()
+{
+    local -a totals
+    printf "%-100s" "query ($(($(wc -l < $DATA) - 1)) rows)"
+    for bin in "$@"; do
+        printf "%28s" "${bin##*/}"
+    done
+    echo
+    for q in "${QUERIES[@]}"; do
+        printf "%-100s" "$q"
+        local i=0
+        for bin in "$@"; do
+            local ms=$(time_query "$bin" "$q")
+            totals[$i]=$(awk -v a="${totals[$i]:-0}" -v b="$ms" 'BEGIN { print a + b }')
+            printf "%26.3fms" $ms
+            i=$((i + 1))
+        done
+        echo
+    done
+    printf "%-100s" "total"
+    for t in "${totals[@]}"; do
+        printf "%26.3fms" $t
+    done
+    echo
+    printf "%-100s" "speedup over ${1##*/}"
+    for t in "${totals[@]}"; do
+        awk -v b="${totals[0]}" -v t="$t" 'BEGIN { printf "%27.2fx", (t > 0 ? b / t : 0) }'
+    done
+    echo
+}
+
+# Prints the best-of-RUNS throughput in MB/s of a scan that selects no rows,
+# with the dataset evicted from the page cache before every run (cold) and
+# with it cached (warm).
+io_throughput()
+{
+    local scan="--filter=YEAR --value=0"
+    local mb=$(awk -v b="$(wc -c < $DATA)" 'BEGIN { print b / 1e6 }')
+    printf "%-40s%16s%16s\n" "scan of $DATA (${mb} MB)" "cold MB/s" "warm MB/s"
+    for bin in "$@"; do
+        local cold=$(for ((r = 0; r < RUNS; r++)); do
+            dd if=$DATA iflag=nocache count=0 2> /dev/null
+            local start=$(date +%s%N)
+            run_query "$bin" "$scan"
+            echo "$start $(date +%s%N)" | awk '{ print ($2 - $1) / 1e6 }'
+        done | sort -g | head -1)
+        local warm=$(time_query "$bin" "$scan")
+        awk -v bin="${bin##*/}" -v mb="$mb" -v c="$cold" -v w="$warm" \
+            'BEGIN { printf "%-40s%16.1f%16.1f\n", bin, mb / c * 1e3, mb / w * 1e3 }'
+    done
+}
+
+# Writes APPROX_ROWS (default 2,000,000) synthetic rows with APPROX_ARTISTS
+# (default 200,000) artists whose popularity is log-uniform, so a few
+# artists hold most of the streams.
+make_synthetic()
+{
+    awk -v rows="${APPROX_ROWS:-2000000}" -v artists="${APPROX_ARTISTS:-200000}" 'BEGIN {
+        srand(7)
+        print "track_name,artist(s)_name,artist_count,released_year,released_month,released_day,in_spotify_playlists,streams,in_apple_playlists"
+        for (i = 0; i < rows; i++) {
+            a = int(exp(rand() * log(artists)))
+            printf "Track %d,Artist %d,1,%d,%d,%d,%d,%d,%d\n", i, a, 1990 + int(rand() * 34), 1 + int(rand() * 12),
+                1 + int(rand() * 28), int(rand() * 10000), int(rand() * 1000000000 / a), int(rand() * 500)
+        }
+    }' > approx_data.csv
+}
+
+# Runs the --approx queries on synthetic data and compares them with exact
+# results computed by awk and by the exact --group_by query.
+approx_errors()
+{
+    local bin=${1:-./song_analyzer}
+    make_synthetic
+    echo "approximate queries on $(($(wc -l < approx_data.csv) - 1)) synthetic rows"
+
+    local start=$(date +%s%N)
+    $bin --data=approx_data.csv --approx=DISTINCT --group_by=YEAR > /dev/null
+    local ms=$(echo "$start $(date +%s%N)" | awk '{ printf "%.0f", ($2 - $1) / 1e6 }')
+    awk -F, 'NR == FNR { if (FNR > 1 && !seen[$4 "," $2]++) exact[$4]++; next }
+        FNR > 1 { e = ($2 - exact[$1]) / exact[$1]; e = e < 0 ? -e : e; sum += e; n++; if (e > max) max = e }
+        END { printf "DISTINCT per year: %d years, mean error %.2f%%, max error %.2f%% (standard error 0.81%%)", n, 100 * sum / n, 100 * max }' \
+        approx_data.csv output.csv
+    echo ", ${ms} ms"
+
+    local k=${APPROX_TOP:-20}
+    start=$(date +%s%N)
+    $bin --data=approx_data.csv --approx=TOP:STREAMS --limit=$k > /dev/null
+    ms=$(echo "$start $(date +%s%N)" | awk '{ printf "%.0f", ($2 - $1) / 1e6 }')
+    cp output.csv approx_top.csv
+    start=$(date +%s%N)
+    $bin --data=approx_data.csv --group_by=ARTIST --agg=SUM:STREAMS --order=DES > /dev/null
+    local exact_ms=$(echo "$start $(date +%s%N)" | awk '{ printf "%.0f", ($2 - $1) / 1e6 }')
+    awk -F, -v k=$k 'NR == FNR { if (FNR > 1) { exact[$1] = $2; if (FNR <= k + 1) top[$1] = 1 } next }
+        FNR > 1 { hits += ($1 in top); e = ($2 - exact[$1]) / exact[$1]; if (e > max) max = e
+                  if (exact[$1] > $2 || exact[$1] < $2 - $3) broken++ }
+        END { printf "TOP:STREAMS: %d of the exact top %d found, max overestimate %.4f%%, %d totals outside their bounds", hits, k, 100 * max, broken }' \
+        output.csv approx_top.csv
+    echo ", ${ms} ms (exact --group_by: ${exact_ms} ms)"
+
+    $bin --data=approx_data.csv --approx=SAMPLE --limit=10000 --order_by=STREAMS > /dev/null
+    awk -F, 'NR == FNR { if (FNR > 1) { sum += $8; n++ } next }
+        FNR > 1 { s += $NF; m++ }
+        END { printf "SAMPLE: %d rows, mean streams %.0f against %.0f exact (%.2f%% off)\n", m, s / m, sum / n, 100 * (s / m - sum / n) / (sum / n) }' \
+        approx_data.csv output.csv
+    rm -f approx_top.csv
+}
+
+if [ "$1" = "--approx" ]; then
+    approx_errors "$2"
+    exit 0
+fi
+
+make_data
+
+if [ "$1" = "--train" ]; then
+    for q in "${QUERIES[@]}"; do
+        run_query "$2" "$q"
+    done
+    exit 0
+fi
+
+if [ "$1" = "--sort" ]; then
+    make -s > /dev/null || exit 1
+    STAGE=${STAGE:-sort} compare "./song_analyzer --sort=MERGE" "./song_analyzer --sort=RADIX"
+    exit 0
+fi
+
+if [ "$1" = "--io" ]; then
+    shift
+    [ $# -gt 0 ] || set -- ./song_analyzer
+    io_throughput "$@"
+    exit 0
+fi
+
+if [ $# -gt 0 ]; then
+    compare "$@"
+    exit 0
+fi
+
+mkdir -p bench_bin
+for config in debug release pgo; do
+    make -s $config > /dev/null || exit 1
+    cp song_analyzer bench_bin/song_analyzer.$config
+done
+compare bench_bin/song_analyzer.debug bench_bin/song_analyzer.release bench_bin/song_analyzer.pgo
@@ -0,0 +1,250 @@
+/** @file colfile.c
+ *  @brief Implementation of colfile.h
+ *
+ */
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "colfile.h"
+#include "emalloc.h"
+#include "section.h"
+#include "stats.h"
+#include "table.h"
+#include "zonemap.h"
+
+/**
+ * @brief Tells whether a file is a column file, by its magic.
+ *
+ * @param path The file to check.
+ * @return int 1 if it is a column file, 0 otherwise.
+ */
+int is_colfile(const char *path)
+{
+    char magic[8];
+    FILE *file = fopen(path, "rb");
+    if (file == NULL)
+    {
+        return 0;
+    }
+    int result = fread(magic, 1, sizeof(magic), file) == sizeof(magic) && strcmp(magic, COLFILE_MAGIC) == 0;
+    fclose(file);
+    return result;
+}
+
+/**
+ * @brief Writes the given rows of a song table to a column file.
+ *
+ * @param path The file to write.
+ * @param table The table the rows belong to.
+ * @param rows The row ids to write, in order.
+ * @param count The number of row ids.
+ * @return int 0 on success, -1 on error (reported with perror).
+ */
+int write_colfile(const char *path, const song_table *table, const int *rows, int count)
+{
+    FILE *file = fopen(path, "wb");
+    if (file == NULL)
+    {
+        perror(path);
+        return -1;
+    }
+
+    colfile_header header;
+    memset(&header, 0, sizeof(header));
+    strcpy(header.magic, COLFILE_MAGIC);
+    header.version = COLFILE_VERSION;
+    header.rows = count;
+    for (int i = 0; i < count; i++)
+    {
+        header.heap_size += strlen(table->track_name[rows[i]]) + 1 + strlen(table->artists_name[rows[i]]) + 1;
+    }
+    header.zone_count = zone_count(count);
+    header.zone_rows = ZONE_BLOCK_ROWS;
+    write_section(file, &header, sizeof(header));
+
+    zone_map *zones = (zone_map *)emalloc((header.zone_count > 0 ? header.zone_count : 1) * sizeof(zone_map));
+    build_zone_maps(table, rows, count, zones);
+    write_section(file, zones, header.zone_count * sizeof(zone_map));
+    free(zones);
+
+    // gather each column into one buffer so it is written sequentially
+    size_t n = count > 0 ? count : 1;
+    int32_t *ints = (int32_t *)emalloc(n * sizeof(int32_t));
+    int64_t *longs = (int64_t *)emalloc(n * sizeof(int64_t));
+    const int *int_columns[] = {table->artist_count, table->released_year, table->released_month,
+                                table->released_day, table->in_spotify_playlists, table->in_apple_playlists};
+    for (int c = 0; c < 6; c++)
+    {
+        for (int i = 0; i < count; i++)
+        {
+            ints[i] = int_columns[c][rows[i]];
+        }
+        write_section(file, ints, count * sizeof(int32_t));
+    }
+    for (int i = 0; i < count; i++)
+    {
+        longs[i] = table->streams[rows[i]];
+    }
+    write_section(file, longs, count * sizeof(int64_t));
+
+    // the heap holds the track names of every row, then the artist names
+    uint32_t *offsets = (uint32_t *)ints;
+    uint32_t offset = 0;
+    for (int i = 0; i < count; i++)
+    {
+        offsets[i] = offset;
+        offset += strlen(table->track_name[rows[i]]) + 1;
+    }
+    write_section(file, offsets, count * sizeof(uint32_t));
+    for (int i = 0; i < count; i++)
+    {
+        offsets[i] = offset;
+        offset += strlen(table->artists_name[rows[i]]) + 1;
+    }
+    write_section(file, offsets, count * sizeof(uint32_t));
+    for (int i = 0; i < count; i++)
+    {
+        fwrite(table->track_name[rows[i]], 1, strlen(table->track_name[rows[i]]) + 1, file);
+    }
+    for (int i = 0; i < count; i++)
+    {
+        fwrite(table->artists_name[rows[i]], 1, strlen(table->artists_name[rows[i]]) + 1, file);
+    }
+
+    free(ints);
+    free(longs);
+    if (fclose(file) != 0)
+    {
+        perror(path);
+        return -1;
+    }
+    return 0;
+}
+
+/**
+ * @brief Reads and checks the header of a column file.
+ *
+ * @return int 0 on success, -1 if the file is not a column file of this version.
+ */
+static int read_header(FILE *file, const char *path, colfile_header *header)
+{
+    if (read_section(file, header, sizeof(*header)) != 0 || strcmp(header->magic, COLFILE_MAGIC) != 0)
+    {
+        fprintf(stderr, "%s: not a song column file\n", path);
+        return -1;
+    }
+    if (header->version != COLFILE_VERSION)
+    {
+        fprintf(stderr, "%s: unsupported column file version %u (rewrite it with --partition)\n", path,
+                header->version);
+        return -1;
+    }
+    return 0;
+}
+
+/**
+ * @brief Loads one or more column files into a single song table.
+ *
+ * The rows of the files are concatenated in the order the files are given.
+ * Every column is read straight into its place in the table, and the string
+ * heaps of all files are read into the table's single heap. The zone maps of
+ * all files are kept in the table, renumbered to its rows. The artist names
+ * are packed (see table_pack_artists); those of a single file already are. An unreadable or
+ * invalid file ends the program.
+ *
+ * @param paths The files to load.
+ * @param count The number of files.
+ * @return song_table* The loaded table.
+ */
+song_table *read_colfiles(char *const *paths, int count)
+{
+    FILE **files = (FILE **)emalloc((count > 0 ? count : 1) * sizeof(FILE *));
+    colfile_header *headers = (colfile_header *)emalloc((count > 0 ? count : 1) * sizeof(colfile_header));
+    long long rows = 0;
+    size_t heap_size = 0;
+    int zones = 0;
+
+    for (int f = 0; f < count; f++)
+    {
+        files[f] = fopen(paths[f], "rb");
+        if (files[f] == NULL)
+        {
+            perror(paths[f]);
+            exit(1);
+        }
+        if (read_header(files[f], paths[f], &headers[f]) != 0)
+        {
+            exit(1);
+        }
+        if (headers[f].zone_count > headers[f].rows)
+        {
+            fprintf(stderr, "%s: truncated or corrupt song column file\n", paths[f]);
+            exit(1);
+        }
+        rows += headers[f].rows;
+        heap_size += headers[f].heap_size;
+        zones += headers[f].zone_count;
+    }
+
+    song_table *table = new_table((int)rows);
+    table->heap = (char *)emalloc(heap_size > 0 ? heap_size : 1);
+    table->zones = (zone_map *)emalloc((zones > 0 ? zones : 1) * sizeof(zone_map));
+
+    int row = 0;
+    size_t heap_offset = 0;
+    uint32_t *offsets = (uint32_t *)emalloc((rows > 0 ? rows : 1) * sizeof(uint32_t));
+    for (int f = 0; f < count; f++)
+    {
+        FILE *file = files[f];
+        int n = headers[f].rows;
+        int *int_columns[] = {table->artist_count, table->released_year, table->released_month,
+                              table->released_day, table->in_spotify_playlists, table->in_apple_playlists};
+        int failed = read_section(file, table->zones + table->zone_count, headers[f].zone_count * sizeof(zone_map));
+        // the blocks must cover the file's rows in order
+        int next = 0;
+        for (uint32_t z = 0; z < headers[f].zone_count && !failed; z++)
+        {
+            zone_map *zone = &table->zones[table->zone_count++];
+            failed |= zone->first_row != next || zone->rows <= 0 || zone->rows > n - next;
+            next += zone->rows;
+            zone->first_row += row;
+        }
+        failed |= next != n;
+        for (int c = 0; c < 6; c++)
+        {
+            failed |= read_section(file, int_columns[c] + row, n * sizeof(int32_t));
+        }
+        failed |= read_section(file, table->streams + row, n * sizeof(int64_t));
+
+        char *heap = table->heap + heap_offset;
+        uint64_t size = headers[f].heap_size;
+        failed |= read_section(file, offsets, n * sizeof(uint32_t));
+        for (int i = 0; i < n; i++)
+        {
+            failed |= offsets[i] >= size;
+            table->track_name[row + i] = heap + offsets[i];
+        }
+        failed |= read_section(file, offsets, n * sizeof(uint32_t));
+        for (int i = 0; i < n; i++)
+        {
+            failed |= offsets[i] >= size;
+            table->artists_name[row + i] = heap + offsets[i];
+        }
+        if (failed || fread(heap, 1, size, file) != size || (size > 0 && heap[size - 1] != '\0'))
+        {
+            fprintf(stderr, "%s: truncated or corrupt song column file\n", paths[f]);
+            exit(1);
+        }
+
+        stats.bytes_read += ftell(file);
+        fclose(file);
+        row += n;
+        heap_offset += headers[f].heap_size;
+    }
+
+    free(offsets);
+    free(files);
+    free(headers);
+    table_pack_artists(table);
+    return table;
+}
@@ -0,0 +1,54 @@
+/** @file colfile.h
+ *  @brief Function prototypes for the binary columnar song file format.
+ *
+ * A column file stores a set of songs column by column so it can be loaded
+ * without parsing:
+ *
+ *     header        colfile_header
+ *     zone maps     zone_map[zone_count]  statistics of each block of rows
+ *     artist_count  int32[rows]
+ *     released_year int32[rows]
+ *     released_month int32[rows]
+ *     released_day  int32[rows]
+ *     in_spotify_playlists int32[rows]
+ *     in_apple_playlists int32[rows]
+ *     streams       int64[rows]
+ *     track_name    uint32[rows]  offsets into the string heap
+ *     artists_name  uint32[rows]  offsets into the string heap
+ *     heap          NUL-terminated strings, heap_size bytes
+ *
+ * Every section starts at a multiple of 8 bytes. Values are stored in the
+ * byte order of the machine that wrote the file.
+ */
+#ifndef _COLFILE_H_
+#define _COLFILE_H_
+
+#include <stdint.h>
+#include "table.h"
+#include "zonemap.h"
+
+#define COLFILE_MAGIC "SONGCOL"
+#define COLFILE_VERSION 2
+
+/**
+ * @brief An struct that represents the header at the start of a column file.
+ */
+typedef struct
+{
+    char magic[8];
+    uint32_t version;
+    uint32_t rows;
+    uint64_t heap_size;
+    uint32_t zone_count;
+    uint32_t zone_rows;
+} colfile_header;
+
+/**
+ * Function protypes associated with column files.
+ *
+ */
+int is_colfile(const char *path);
+int write_colfile(const char *path, const song_table *table, const int *rows, int count);
+song_table *read_colfiles(char *const *paths, int count);
+
+#endif
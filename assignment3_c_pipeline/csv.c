@@ -0,0 +1,336 @@
+/** @file csv.c
+ *  @brief Implementation of csv.h
+ *
+ */
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <string.h>
+#ifdef __AVX2__
+#include <immintrin.h>
+#endif
+#include "csv.h"
+#include "emalloc.h"
+
+/**
+ * @brief The classes of bytes the state machine distinguishes.
+ */
+enum
+{
+    CLASS_OTHER,
+    CLASS_COMMA,
+    CLASS_QUOTE,
+    CLASS_NEWLINE,
+    CLASS_END,
+    CLASS_COUNT
+};
+
+/**
+ * @brief The states of the state machine.
+ *
+ * STATE_FIELD and STATE_RECORD are reached at the end of a field, followed by
+ * another field or by the end of the record.
+ */
+enum
+{
+    STATE_START,
+    STATE_PLAIN,
+    STATE_QUOTED,
+    STATE_QUOTE,
+    STATE_FIELD,
+    STATE_RECORD,
+    STATE_STRAY_QUOTE,
+    STATE_AFTER_QUOTE,
+    STATE_UNTERMINATED
+};
+
+/**
+ * @brief The number of states that read more bytes; the others end a field.
+ */
+#define RUNNING_STATES 4
+
+/**
+ * @brief The class of every byte; '\r' ends a record like '\n'.
+ */
+static const unsigned char byte_class[256] = {
+    [0] = CLASS_END, [','] = CLASS_COMMA, ['"'] = CLASS_QUOTE, ['\n'] = CLASS_NEWLINE, ['\r'] = CLASS_NEWLINE,
+};
+
+/**
+ * @brief The transitions: next_state[state][class].
+ */
+static const unsigned char next_state[RUNNING_STATES][CLASS_COUNT] = {
+    // start of a field
+    [STATE_START] = {STATE_PLAIN, STATE_FIELD, STATE_QUOTED, STATE_RECORD, STATE_RECORD},
+    // inside an unquoted field
+    [STATE_PLAIN] = {STATE_PLAIN, STATE_FIELD, STATE_STRAY_QUOTE, STATE_RECORD, STATE_RECORD},
+    // inside a quoted field: commas and newlines are data
+    [STATE_QUOTED] = {STATE_QUOTED, STATE_QUOTED, STATE_QUOTE, STATE_QUOTED, STATE_UNTERMINATED},
+    // a quote inside a quoted field: either doubled or the closing one
+    [STATE_QUOTE] = {STATE_AFTER_QUOTE, STATE_FIELD, STATE_QUOTED, STATE_RECORD, STATE_RECORD},
+};
+
+/**
+ * @brief Splits the next field off a record.
+ *
+ * @param p The start of the field.
+ * @param field Set to the field.
+ * @return const char* The start of the next field, or NULL if this was the
+ * last field or the field is malformed.
+ */
+const char *csv_next_field(const char *p, csv_field *field)
+{
+    const char *start = p;
+    int state = STATE_START;
+    while ((state = next_state[state][byte_class[(unsigned char)*p]]) < RUNNING_STATES)
+    {
+        p++;
+        // the common unquoted path: skip ordinary bytes without a table lookup
+        // per byte that depends on the previous one
+        if (state == STATE_PLAIN)
+        {
+            while (byte_class[(unsigned char)*p] == CLASS_OTHER)
+            {
+                p++;
+            }
+        }
+    }
+
+    static const char *const errors[] = {"quote inside an unquoted field", "text after a closing quote",
+                                         "unterminated quoted field"};
+    field->quoted = *start == '"';
+    field->start = start + field->quoted;
+    field->length = (int)(p - start) - 2 * field->quoted;
+    field->error = state >= STATE_STRAY_QUOTE ? errors[state - STATE_STRAY_QUOTE] : NULL;
+    return state == STATE_FIELD ? p + 1 : NULL;
+}
+
+/**
+ * @brief Copies the value of a field into a buffer, undoubling the quotes of a quoted field.
+ *
+ * @param field The field.
+ * @param value The buffer; it needs room for field->length + 1 bytes.
+ * @return int The length of the value, which is followed by a NUL.
+ */
+int csv_field_copy(const csv_field *field, char *value)
+{
+    if (!field->quoted)
+    {
+        memcpy(value, field->start, field->length);
+        value[field->length] = '\0';
+        return field->length;
+    }
+    int n = 0;
+    for (int i = 0; i < field->length; i++)
+    {
+        value[n++] = field->start[i];
+        i += field->start[i] == '"';
+    }
+    value[n] = '\0';
+    return n;
+}
+
+/**
+ * @brief Copies the value of a field into a new string, undoubling the quotes of a quoted field.
+ *
+ * @param field The field.
+ * @return char* The value.
+ */
+char *csv_field_dup(const csv_field *field)
+{
+    char *value = (char *)emalloc(field->length + 1);
+    csv_field_copy(field, value);
+    return value;
+}
+
+/**
+ * @brief Tells whether a line of a record ends inside a quoted field, so that the record continues on the next line.
+ *
+ * Runs the state machine of csv_next_field over the line. Only a field that
+ * opened with a quote can hold a newline: a stray quote in an unquoted field,
+ * or text after a closing quote, leaves the field malformed but still ends
+ * the record at the newline.
+ *
+ * @param line The line, including its newline.
+ * @param length The number of bytes of the line.
+ * @param quoted Whether the line starts inside a quoted field, i.e. the previous line of the record continues.
+ * @return int 1 if the line ends inside a quoted field, 0 if it ends the record.
+ */
+int csv_line_continues(const char *line, size_t length, int quoted)
+{
+    int state = quoted ? STATE_QUOTED : STATE_START;
+    for (size_t i = 0; i < length; i++)
+    {
+        state = next_state[state][byte_class[(unsigned char)line[i]]];
+        if (state == STATE_RECORD)
+        {
+            return 0;
+        }
+        if (state == STATE_FIELD)
+        {
+            state = STATE_START;
+        }
+        else if (state == STATE_STRAY_QUOTE || state == STATE_AFTER_QUOTE)
+        {
+            state = STATE_PLAIN;
+        }
+        else if (state == STATE_UNTERMINATED)
+        {
+            state = STATE_QUOTED;
+        }
+    }
+    return state == STATE_QUOTED;
+}
+
+/**
+ * @brief Tells whether a field holds an integer the way "%d" reads one: blanks, a sign and digits.
+ */
+static int is_number(const csv_field *field)
+{
+    const char *p = field->start;
+    const char *end = p + field->length;
+    while (p < end && (*p == ' ' || *p == '\t'))
+    {
+        p++;
+    }
+    if (p < end && (*p == '-' || *p == '+'))
+    {
+        p++;
+    }
+    const char *digits = p;
+    while (p < end && *p >= '0' && *p <= '9')
+    {
+        p++;
+    }
+    return p > digits && p == end;
+}
+
+/**
+ * @brief Checks an unquoted record whose numeric fields are plain digits, without the state machine.
+ *
+ * The numeric fields are checked 32 bytes at a time when the compiler
+ * targets AVX2: one compare each for digits and commas, and a shift of the
+ * comma mask to find empty fields.
+ *
+ * @return int 1 if the record is well-formed, 0 if it must be checked by the state machine.
+ */
+static int check_plain_record(const char *record, size_t length, int fields, int first_number)
+{
+    if (memchr(record, '"', length) != NULL)
+    {
+        return 0;
+    }
+    const char *p = record;
+    const char *end = record + length;
+    while (end > record && (end[-1] == '\n' || end[-1] == '\r'))
+    {
+        end--;
+    }
+    for (int i = 0; i < first_number; i++)
+    {
+        p = (const char *)memchr(p, ',', end - p);
+        if (p == NULL)
+        {
+            return 0;
+        }
+        p++;
+    }
+
+    // every remaining byte must be a digit or a comma, without empty fields
+    int commas = 0;
+    unsigned int after_comma = 1;
+#ifdef __AVX2__
+    const __m256i comma = _mm256_set1_epi8(',');
+    const __m256i below_zero = _mm256_set1_epi8('0' - 1);
+    const __m256i above_nine = _mm256_set1_epi8('9' + 1);
+    for (; end - p >= 32; p += 32)
+    {
+        __m256i x = _mm256_loadu_si256((const __m256i *)p);
+        uint32_t comma_mask = (uint32_t)_mm256_movemask_epi8(_mm256_cmpeq_epi8(x, comma));
+        __m256i digit = _mm256_and_si256(_mm256_cmpgt_epi8(x, below_zero), _mm256_cmpgt_epi8(above_nine, x));
+        uint32_t digit_mask = (uint32_t)_mm256_movemask_epi8(digit);
+        if ((comma_mask | digit_mask) != 0xffffffffu || (comma_mask & (comma_mask << 1 | after_comma)) != 0)
+        {
+            return 0;
+        }
+        commas += __builtin_popcount(comma_mask);
+        after_comma = comma_mask >> 31;
+    }
+#endif
+    for (; p < end; p++)
+    {
+        unsigned int is_comma = *p == ',';
+        if ((!is_comma && (*p < '0' || *p > '9')) || (is_comma && after_comma))
+        {
+            return 0;
+        }
+        commas += is_comma;
+        after_comma = is_comma;
+    }
+    return !after_comma && commas == fields - first_number - 1;
+}
+
+/**
+ * @brief Checks that a record has the expected fields and that its numeric fields are integers.
+ *
+ * @param record The record (it may hold the newlines of quoted fields).
+ * @param length The length of the record.
+ * @param fields The number of fields expected.
+ * @param first_number The index of the first numeric field; every later field is numeric.
+ * @return const char* NULL for a well-formed record, otherwise what is wrong with it.
+ */
+const char *csv_check_record(const char *record, size_t length, int fields, int first_number)
+{
+    if (check_plain_record(record, length, fields, first_number))
+    {
+        return NULL;
+    }
+
+    const char *p = record;
+    int count = 0;
+    while (p != NULL)
+    {
+        csv_field field;
+        const char *next = csv_next_field(p, &field);
+        if (field.error != NULL)
+        {
+            return field.error;
+        }
+        if (count >= fields)
+        {
+            return "too many fields";
+        }
+        if (count >= first_number && !is_number(&field))
+        {
+            return "numeric field is not a number";
+        }
+        count++;
+        p = next;
+    }
+    return count < fields ? "too few fields" : NULL;
+}
+
+/**
+ * @brief Writes a value as a csv field, quoting it if it holds a comma, quote or newline.
+ *
+ * @param out The stream to write to.
+ * @param value The value.
+ */
+void csv_write_field(FILE *out, const char *value)
+{
+    if (strpbrk(value, ",\"\r\n") == NULL)
+    {
+        fputs(value, out);
+        return;
+    }
+    putc('"', out);
+    for (const char *c = value; *c != '\0'; c++)
+    {
+        if (*c == '"')
+        {
+            putc('"', out);
+        }
+        putc(*c, out);
+    }
+    putc('"', out);
+}
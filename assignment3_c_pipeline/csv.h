@@ -0,0 +1,40 @@
+/** @file csv.h
+ *  @brief Function prototypes for splitting and writing RFC 4180 csv records.
+ *
+ * A record is split by a table-driven state machine: every byte is mapped to
+ * a class (comma, quote, newline, end of string or other) and the next state
+ * is looked up from the current state and that class. Fields may be quoted;
+ * a quoted field may hold commas, newlines and doubled quotes ("").
+ */
+#ifndef _CSV_H_
+#define _CSV_H_
+
+#include <stdio.h>
+
+/**
+ * @brief An struct that represents one field of a record, as found by csv_next_field.
+ *
+ * For a quoted field `start` and `length` cover the text between the quotes,
+ * still holding its doubled quotes. `error` says what is wrong with a
+ * malformed field and is NULL otherwise.
+ */
+typedef struct
+{
+    const char *start;
+    int length;
+    int quoted;
+    const char *error;
+} csv_field;
+
+/**
+ * Function protypes associated with csv records.
+ *
+ */
+const char *csv_next_field(const char *p, csv_field *field);
+int csv_field_copy(const csv_field *field, char *value);
+char *csv_field_dup(const csv_field *field);
+int csv_line_continues(const char *line, size_t length, int quoted);
+const char *csv_check_record(const char *record, size_t length, int fields, int first_number);
+void csv_write_field(FILE *out, const char *value);
+
+#endif
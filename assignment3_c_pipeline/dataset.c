@@ -0,0 +1,387 @@
+/** @file dataset.c
+ *  @brief Implementation of dataset.h
+ *
+ */
+#include <dirent.h>
+#include <errno.h>
+#include <glob.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#include "colfile.h"
+#include "dataset.h"
+#include "emalloc.h"
+#include "functions.h"
+#include "reader.h"
+#include "scan.h"
+#include "sort.h"
+#include "stats.h"
+#include "table.h"
+
+/**
+ * @brief Splits "--data" into the paths it names, expanding glob patterns.
+ *
+ * The matches of a pattern are sorted by name; a pattern without matches is
+ * kept as is, so that opening it reports the missing file.
+ *
+ * @param data The comma-separated list of paths and patterns.
+ * @param count Set to the number of paths.
+ * @return char** The paths, to be freed with free_data_paths.
+ */
+char **expand_data_paths(const char *data, int *count)
+{
+    char *list = strdup(data);
+    int capacity = 8;
+    char **paths = (char **)emalloc(capacity * sizeof(char *));
+    *count = 0;
+
+    char *rest = NULL;
+    for (char *pattern = strtok_r(list, ",", &rest); pattern != NULL; pattern = strtok_r(NULL, ",", &rest))
+    {
+        glob_t matches;
+        if (glob(pattern, GLOB_NOCHECK, NULL, &matches) != 0)
+        {
+            fprintf(stderr, "%s: cannot expand pattern\n", pattern);
+            exit(1);
+        }
+        for (size_t i = 0; i < matches.gl_pathc; i++)
+        {
+            if (*count == capacity)
+            {
+                capacity *= 2;
+                char **bigger = (char **)emalloc(capacity * sizeof(char *));
+                memcpy(bigger, paths, *count * sizeof(char *));
+                free(paths);
+                paths = bigger;
+            }
+            paths[(*count)++] = strdup(matches.gl_pathv[i]);
+        }
+        globfree(&matches);
+    }
+    free(list);
+
+    if (*count == 0)
+    {
+        fprintf(stderr, "--data names no files: %s\n", data);
+        exit(1);
+    }
+    return paths;
+}
+
+/**
+ * @brief Frees the paths returned by expand_data_paths.
+ *
+ * @param paths The paths.
+ * @param count The number of paths.
+ */
+void free_data_paths(char **paths, int count)
+{
+    for (int i = 0; i < count; i++)
+    {
+        free(paths[i]);
+    }
+    free(paths);
+}
+
+/**
+ * @brief Tells whether "--data" names a csv file (rather than a directory or a column file).
+ *
+ * @param path The data path.
+ * @return int 1 for a csv file, 0 otherwise.
+ */
+int is_csv_file(const char *path)
+{
+    struct stat st;
+    return stat(path, &st) == 0 && S_ISREG(st.st_mode) && !is_colfile(path);
+}
+
+/**
+ * @brief Loads a csv file into a song table.
+ *
+ * @param path The csv file.
+ * @param columns The COL_* flags of the columns to parse for every row.
+ * @return song_table* The loaded table.
+ */
+song_table *load_csv(const char *path, unsigned int columns)
+{
+    node_t *lines = turn_data_into_list(path);
+    return table_from_list(lines, columns);
+}
+
+/**
+ * @brief Loads the data named by "--data" into a song table.
+ *
+ * Partitions whose year the filter rules out are not read at all. Only the
+ * requested columns of a csv file are parsed up front; binary files always
+ * load every column.
+ *
+ * @param path A csv file, a column file or a partitioned directory.
+ * @param filter The query's filter, used to prune partitions; may be NULL.
+ * @param columns The COL_* flags of the columns the query filters, sorts or groups on.
+ * @return song_table* The loaded table.
+ */
+song_table *load_dataset(const char *path, const filter_expr *filter, unsigned int columns)
+{
+    struct stat st;
+    if (stat(path, &st) != 0)
+    {
+        perror(path);
+        exit(1);
+    }
+    if (S_ISDIR(st.st_mode))
+    {
+        return load_partitions(path, filter);
+    }
+    if (is_colfile(path))
+    {
+        char *paths[] = {(char *)path};
+        return read_colfiles(paths, 1);
+    }
+    return load_csv(path, columns);
+}
+
+/**
+ * @brief Loads the union of several datasets into one song table, in the order they are given.
+ *
+ * The datasets must all be csv files or all be column files; a mix, or
+ * several partitioned directories, ends the program.
+ *
+ * @param paths The datasets.
+ * @param count The number of datasets.
+ * @param filter The query's filter, used to prune partitions; may be NULL.
+ * @param columns The COL_* flags of the columns the query filters, sorts or groups on.
+ * @return song_table* The loaded table.
+ */
+song_table *load_datasets(char *const *paths, int count, const filter_expr *filter, unsigned int columns)
+{
+    if (count == 1)
+    {
+        return load_dataset(paths[0], filter, columns);
+    }
+
+    int csv_files = 0, colfiles = 0;
+    for (int i = 0; i < count; i++)
+    {
+        csv_files += is_csv_file(paths[i]);
+        colfiles += is_colfile(paths[i]);
+    }
+    if (colfiles == count)
+    {
+        return read_colfiles(paths, count);
+    }
+    if (csv_files != count)
+    {
+        fprintf(stderr, "--data: this query can only combine csv files or column files, not both or directories\n");
+        exit(1);
+    }
+
+    // chain the lines of every file into one list
+    node_t *head = NULL;
+    node_t *tail = NULL;
+    for (int i = 0; i < count; i++)
+    {
+        line_reader *reader = open_reader(paths[i]);
+        node_t *lines = read_line_chunk(reader, (size_t)-1, NULL);
+        close_reader(reader);
+        if (lines == NULL)
+        {
+            continue;
+        }
+        if (tail == NULL)
+        {
+            head = lines;
+        }
+        else
+        {
+            tail->next = lines;
+        }
+        tail = lines;
+        while (tail->next != NULL)
+        {
+            tail = tail->next;
+        }
+    }
+    return table_from_list(head, columns);
+}
+
+/**
+ * @brief Parses a partition file name, "year=<year>.songs".
+ *
+ * @return int 1 and sets `year` if the name is a partition, 0 otherwise.
+ */
+static int partition_year(const char *name, int *year)
+{
+    int end = 0;
+    if (sscanf(name, PARTITION_PREFIX "%d%n", year, &end) != 1)
+    {
+        return 0;
+    }
+    return strcmp(name + end, PARTITION_SUFFIX) == 0;
+}
+
+/**
+ * @brief An struct that pairs a partition file with its year, for sorting.
+ */
+typedef struct
+{
+    int year;
+    char *path;
+} partition;
+
+/**
+ * @brief qsort comparator: partitions in increasing year.
+ */
+static int compare_partitions(const void *a, const void *b)
+{
+    int x = ((const partition *)a)->year;
+    int y = ((const partition *)b)->year;
+    return (x > y) - (x < y);
+}
+
+/**
+ * @brief Loads the partitions of a partitioned directory that the filter may select from.
+ *
+ * The partitions are loaded in increasing year, so rows are ordered by year
+ * and then by their order in the original data.
+ *
+ * @param dir The partitioned directory.
+ * @param filter The query's filter; NULL loads every partition.
+ * @return song_table* The loaded table.
+ */
+song_table *load_partitions(const char *dir, const filter_expr *filter)
+{
+    DIR *d = opendir(dir);
+    if (d == NULL)
+    {
+        perror(dir);
+        exit(1);
+    }
+
+    int count = 0, capacity = 16;
+    partition *partitions = (partition *)emalloc(capacity * sizeof(partition));
+    struct dirent *entry;
+    while ((entry = readdir(d)) != NULL)
+    {
+        int year;
+        if (!partition_year(entry->d_name, &year))
+        {
+            continue;
+        }
+        if (!filter_may_select_year(filter, year))
+        {
+            stats.partitions_pruned++;
+            continue;
+        }
+        if (count == capacity)
+        {
+            capacity *= 2;
+            partition *bigger = (partition *)emalloc(capacity * sizeof(partition));
+            memcpy(bigger, partitions, count * sizeof(partition));
+            free(partitions);
+            partitions = bigger;
+        }
+        partitions[count].year = year;
+        partitions[count].path = (char *)emalloc(strlen(dir) + strlen(entry->d_name) + 2);
+        sprintf(partitions[count].path, "%s/%s", dir, entry->d_name);
+        count++;
+    }
+    closedir(d);
+
+    qsort(partitions, count, sizeof(partition), compare_partitions);
+    char **paths = (char **)emalloc((count > 0 ? count : 1) * sizeof(char *));
+    for (int i = 0; i < count; i++)
+    {
+        paths[i] = partitions[i].path;
+    }
+    stats.partitions_read += count;
+
+    song_table *table = read_colfiles(paths, count);
+
+    for (int i = 0; i < count; i++)
+    {
+        free(paths[i]);
+    }
+    free(paths);
+    free(partitions);
+    return table;
+}
+
+/**
+ * @brief Writes a song table as a directory partitioned by release year.
+ *
+ * The directory is created if needed and partitions left in it by an earlier
+ * conversion are removed. Each year is written as one column file holding
+ * that year's songs in their original order.
+ *
+ * @param table The table to partition.
+ * @param dir The directory to write.
+ * @return int The number of partitions written, or -1 on error.
+ */
+int partition_dataset(const song_table *table, const char *dir)
+{
+    if (mkdir(dir, 0777) != 0 && errno != EEXIST)
+    {
+        perror(dir);
+        return -1;
+    }
+
+    DIR *d = opendir(dir);
+    if (d == NULL)
+    {
+        perror(dir);
+        return -1;
+    }
+    struct dirent *entry;
+    char *path = (char *)emalloc(strlen(dir) + 256 + 2);
+    while ((entry = readdir(d)) != NULL)
+    {
+        int year;
+        if (partition_year(entry->d_name, &year))
+        {
+            sprintf(path, "%s/%s", dir, entry->d_name);
+            unlink(path);
+        }
+    }
+    closedir(d);
+
+    // a stable sort by year keeps each partition in the original order
+    int rows = table->rows;
+    sort_entry *entries = (sort_entry *)emalloc((rows > 0 ? rows : 1) * sizeof(sort_entry));
+    int *row_ids = (int *)emalloc((rows > 0 ? rows : 1) * sizeof(int));
+    for (int i = 0; i < rows; i++)
+    {
+        entries[i].key = (uint64_t)(int64_t)table->released_year[i] ^ ((uint64_t)1 << 63);
+        entries[i].row = i;
+    }
+    radix_sort_entries(entries, rows);
+    for (int i = 0; i < rows; i++)
+    {
+        row_ids[i] = entries[i].row;
+    }
+
+    int partitions = 0;
+    for (int lo = 0; lo < rows;)
+    {
+        int year = table->released_year[row_ids[lo]];
+        int hi = lo;
+        while (hi < rows && table->released_year[row_ids[hi]] == year)
+        {
+            hi++;
+        }
+        sprintf(path, "%s/" PARTITION_PREFIX "%d" PARTITION_SUFFIX, dir, year);
+        if (write_colfile(path, table, row_ids + lo, hi - lo) != 0)
+        {
+            partitions = -1;
+            break;
+        }
+        partitions++;
+        lo = hi;
+    }
+
+    free(path);
+    free(entries);
+    free(row_ids);
+    return partitions;
+}
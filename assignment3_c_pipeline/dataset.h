@@ -0,0 +1,33 @@
+/** @file dataset.h
+ *  @brief Function prototypes for loading the data named by "--data".
+ *
+ * "--data" may name a csv file, a column file (see colfile.h) or a
+ * directory partitioned by release year, which holds one column file per
+ * year named "year=<year>.songs". It may also list several of them
+ * separated by commas, each of which may be a glob pattern (e.g.
+ * "shards/day-*.csv"); the rows of all of them are queried together, in the
+ * order they are listed.
+ */
+#ifndef _DATASET_H_
+#define _DATASET_H_
+
+#include "scan.h"
+#include "table.h"
+
+#define PARTITION_PREFIX "year="
+#define PARTITION_SUFFIX ".songs"
+
+/**
+ * Function protypes associated with datasets.
+ *
+ */
+char **expand_data_paths(const char *data, int *count);
+void free_data_paths(char **paths, int count);
+int is_csv_file(const char *path);
+song_table *load_csv(const char *path, unsigned int columns);
+song_table *load_dataset(const char *path, const filter_expr *filter, unsigned int columns);
+song_table *load_datasets(char *const *paths, int count, const filter_expr *filter, unsigned int columns);
+song_table *load_partitions(const char *dir, const filter_expr *filter);
+int partition_dataset(const song_table *table, const char *dir);
+
+#endif
@@ -0,0 +1,370 @@
+/** @file extsort.c
+ *  @brief Implementation of extsort.h
+ *
+ * The csv file is read in chunks that fit in the memory budget. Each chunk
+ * is parsed, filtered and sorted like the in-memory path does it, and its
+ * rows are spilled to a temporary file (a "run") in the binary row format of
+ * rowfile.h. The runs are then merged with a loser tree straight into
+ * output.csv.
+ *
+ * The result is the same as the in-memory path: every run holds a
+ * consecutive range of the input, so ordering ties by run (earlier runs first
+ * for ASC, later runs first for DES, which reverses the ascending order) keeps
+ * the sort stable. Since only the first `--limit` rows are written, each run
+ * keeps at most that many rows.
+ */
+#include <ctype.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/resource.h>
+#include "emalloc.h"
+#include "extsort.h"
+#include "functions.h"
+#include "losertree.h"
+#include "output.h"
+#include "reader.h"
+#include "rowfile.h"
+#include "scan.h"
+#include "sort.h"
+#include "stats.h"
+#include "table.h"
+
+/**
+ * @brief Parses a memory size such as "512K", "64M" or "2G" (or a plain number of bytes).
+ *
+ * An invalid size ends the program.
+ *
+ * @param text The size.
+ * @return size_t The size in bytes.
+ */
+size_t parse_memory_size(const char *text)
+{
+    char *end;
+    double size = strtod(text, &end);
+    switch (toupper((unsigned char)*end))
+    {
+    case 'G':
+        size *= 1024;
+        // fall through
+    case 'M':
+        size *= 1024;
+        // fall through
+    case 'K':
+        size *= 1024;
+        end++;
+        break;
+    }
+    if (end == text || size < 1 || (*end != '\0' && toupper((unsigned char)*end) != 'B'))
+    {
+        fprintf(stderr, "invalid memory limit: %s\n", text);
+        exit(1);
+    }
+    return (size_t)size;
+}
+
+/**
+ * @brief An struct that holds the runs being merged and the current row of each.
+ */
+typedef struct
+{
+    int count;
+    FILE **files;
+    song_row *rows;
+    row_buffer *buffers;
+    int *exhausted;
+    int descending;
+} merge_state;
+
+/**
+ * @brief Reads the next row of a run into the merge state.
+ */
+static void advance_run(merge_state *state, int run)
+{
+    int result = read_song_row(state->files[run], &state->rows[run], &state->buffers[run]);
+    if (result < 0)
+    {
+        fprintf(stderr, "corrupt temporary run file\n");
+        exit(1);
+    }
+    state->exhausted[run] = result == 0;
+}
+
+/**
+ * @brief loser_less for runs: by value, then by run so that the merge is stable.
+ */
+static int run_less(int a, int b, void *context)
+{
+    merge_state *state = (merge_state *)context;
+    if (state->exhausted[a] || state->exhausted[b])
+    {
+        return state->exhausted[a] == state->exhausted[b] ? a < b : state->exhausted[b];
+    }
+    long int x = state->rows[a].value;
+    long int y = state->rows[b].value;
+    if (x != y)
+    {
+        return state->descending ? x > y : x < y;
+    }
+    return state->descending ? a > b : a < b;
+}
+
+/**
+ * @brief Merges runs into one output, either a new run or the query output.
+ *
+ * The runs are closed.
+ *
+ * @param files The runs, positioned at their first row.
+ * @param count The number of runs.
+ * @param descending Whether the runs are in descending order.
+ * @param run The run to write to, if `output` is NULL.
+ * @param output The query output to write to, or NULL.
+ * @param limit The most rows to write, or -1 for all.
+ */
+static void merge_runs(FILE **files, int count, int descending, FILE *run, output_writer *output, long limit)
+{
+    merge_state state;
+    state.count = count;
+    state.files = files;
+    state.descending = descending;
+    state.rows = (song_row *)emalloc(count * sizeof(song_row));
+    state.buffers = (row_buffer *)emalloc(count * sizeof(row_buffer));
+    state.exhausted = (int *)emalloc(count * sizeof(int));
+    for (int i = 0; i < count; i++)
+    {
+        state.buffers[i].data = NULL;
+        state.buffers[i].capacity = 0;
+        advance_run(&state, i);
+    }
+
+    loser_tree *tree = new_loser_tree(count, run_less, &state);
+    for (long written = 0; limit < 0 || written < limit; written++)
+    {
+        int winner = loser_tree_winner(tree);
+        if (state.exhausted[winner])
+        {
+            break;
+        }
+        if (output != NULL)
+        {
+            output_row(output, &state.rows[winner]);
+        }
+        else
+        {
+            write_song_row(run, &state.rows[winner]);
+        }
+        advance_run(&state, winner);
+        loser_tree_replay(tree);
+    }
+
+    free_loser_tree(tree);
+    for (int i = 0; i < count; i++)
+    {
+        fclose(files[i]);
+        free(state.buffers[i].data);
+    }
+    free(state.rows);
+    free(state.buffers);
+    free(state.exhausted);
+}
+
+/**
+ * @brief Merges each group of `fan_in` consecutive runs into one run.
+ *
+ * @param runs The runs; replaced by the merged runs, in the same order.
+ * @param run_count The number of runs; updated.
+ * @param fan_in The most runs merged into one.
+ * @param descending Whether the runs are in descending order.
+ * @param max_rows The most rows a merged run needs to keep, or -1 for all.
+ */
+static void merge_pass(FILE **runs, int *run_count, int fan_in, int descending, long max_rows)
+{
+    int merged = 0;
+    for (int lo = 0; lo < *run_count; lo += fan_in)
+    {
+        int n = *run_count - lo < fan_in ? *run_count - lo : fan_in;
+        FILE *run = tmpfile();
+        if (run == NULL)
+        {
+            perror("tmpfile");
+            exit(1);
+        }
+        merge_runs(runs + lo, n, descending, run, NULL, max_rows);
+        rewind(run);
+        runs[merged++] = run;
+    }
+    *run_count = merged;
+    stats.merge_passes++;
+}
+
+/**
+ * @brief Runs a (possibly sorted) row query on a csv file using about `memory_limit` bytes.
+ *
+ * Produces the same output as the in-memory path of main.
+ *
+ * @param path The csv file.
+ * @param filter The filter, or NULL.
+ * @param order_by The "--order_by" field, or NULL to keep the input order.
+ * @param order "ASC", "DES" or NULL.
+ * @param limit The most rows to write, or NULL.
+ * @param memory_limit The memory budget in bytes.
+ * @param algorithm The algorithm used to sort each chunk.
+ * @param format The format of the output.
+ */
+void external_sort_query(const char *path, const filter_expr *filter, const char *order_by, const char *order,
+                         const char *limit, size_t memory_limit, sort_algorithm algorithm, output_format format)
+{
+    order_field field = parse_order_by(order_by);
+    unsigned int columns = filter_columns(filter) | order_columns(field) | COL_OUTPUT;
+    int descending = order != NULL && strcmp(order, "DES") == 0;
+    long max_rows = limit != NULL ? atol(limit) : -1;
+    if (max_rows < -1)
+    {
+        max_rows = 0;
+    }
+
+    if (memory_limit < EXTSORT_MIN_MEMORY)
+    {
+        fprintf(stderr, "--memory-limit must be at least %dM to hold the read and merge buffers\n",
+                EXTSORT_MIN_MEMORY >> 20);
+        exit(1);
+    }
+
+    // the budget first holds the I/O buffers: the two read-ahead buffers and,
+    // for gzip input, the compressed input (at most as large), a stdio buffer
+    // for each open run, which take at most an eighth of it, and the output
+    // buffer
+    size_t read_buffer = memory_limit / 16;
+    if (read_buffer < EXTSORT_MIN_READ_BUFFER)
+    {
+        read_buffer = EXTSORT_MIN_READ_BUFFER;
+    }
+    if (read_buffer > READER_BUFFER_SIZE)
+    {
+        read_buffer = READER_BUFFER_SIZE;
+    }
+    size_t run_memory = memory_limit / 8;
+
+    // the lines take about a third of a chunk; their parsed columns, names,
+    // row ids and sort entries take most of the rest
+    size_t chunk_budget = (memory_limit - 3 * read_buffer - run_memory - OUTPUT_BUFFER_SIZE) / 3;
+
+    // keep the open runs (plus one being written) within their share of the
+    // budget and within half the descriptor limit
+    int max_runs = EXTSORT_MAX_RUNS;
+    if (run_memory / BUFSIZ - 1 < (size_t)max_runs)
+    {
+        max_runs = (int)(run_memory / BUFSIZ) - 1;
+    }
+    int fan_in = EXTSORT_FAN_IN;
+    struct rlimit files_limit;
+    if (getrlimit(RLIMIT_NOFILE, &files_limit) == 0 && files_limit.rlim_cur / 2 < (rlim_t)max_runs)
+    {
+        max_runs = files_limit.rlim_cur / 2 > 2 ? (int)(files_limit.rlim_cur / 2) : 2;
+    }
+    if (fan_in > max_runs)
+    {
+        fan_in = max_runs;
+    }
+
+    line_reader *reader = open_reader_sized(path, read_buffer);
+    int run_count = 0, run_capacity = 16;
+    FILE **runs = (FILE **)emalloc(run_capacity * sizeof(FILE *));
+    output_writer *output = NULL;
+
+    while (1)
+    {
+        double start = stats_now();
+        size_t used;
+        node_t *lines = read_line_chunk(reader, chunk_budget, &used);
+        if (lines == NULL)
+        {
+            break;
+        }
+        song_table *table = table_from_list(lines, columns);
+        stats.rows_loaded += table->rows;
+        stats.load_seconds += stats_now() - start;
+
+        start = stats_now();
+        int count = 0;
+        int *rows = filter_table(table, filter, &count);
+        stats.rows_selected += count;
+        stats.filter_seconds += stats_now() - start;
+
+        start = stats_now();
+        sort_rows(table, rows, count, order_by, algorithm);
+        count = limit_rows(rows, count, order, limit);
+
+        if (run_count == 0 && used < chunk_budget)
+        {
+            // everything fit in one chunk: no need to spill
+            output = open_output(format, order_by);
+            for (int i = 0; i < count; i++)
+            {
+                song_row row;
+                table_row(table, rows[i], field, &row);
+                output_row(output, &row);
+            }
+        }
+        else
+        {
+            FILE *run = tmpfile();
+            if (run == NULL)
+            {
+                perror("tmpfile");
+                exit(1);
+            }
+            for (int i = 0; i < count; i++)
+            {
+                song_row row;
+                table_row(table, rows[i], field, &row);
+                write_song_row(run, &row);
+            }
+            stats.bytes_spilled += ftell(run);
+            rewind(run);
+            if (run_count == run_capacity)
+            {
+                run_capacity *= 2;
+                FILE **bigger = (FILE **)emalloc(run_capacity * sizeof(FILE *));
+                memcpy(bigger, runs, run_count * sizeof(FILE *));
+                free(runs);
+                runs = bigger;
+            }
+            runs[run_count++] = run;
+            stats.runs_spilled++;
+            if (run_count == max_runs)
+            {
+                merge_pass(runs, &run_count, fan_in, descending, max_rows);
+            }
+        }
+        stats.sort_seconds += stats_now() - start;
+
+        free(rows);
+        free_table(table);
+        if (output != NULL)
+        {
+            break;
+        }
+    }
+    close_reader(reader);
+
+    double start = stats_now();
+    if (output == NULL)
+    {
+        // merge groups of consecutive runs until one pass can merge the rest
+        while (run_count > fan_in)
+        {
+            merge_pass(runs, &run_count, fan_in, descending, max_rows);
+        }
+
+        output = open_output(format, order_by);
+        if (run_count > 0)
+        {
+            merge_runs(runs, run_count, descending, NULL, output, max_rows);
+            stats.merge_passes++;
+        }
+    }
+    close_output(output);
+    stats.output_seconds = stats_now() - start;
+    free(runs);
+}
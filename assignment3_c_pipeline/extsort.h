@@ -0,0 +1,44 @@
+/** @file extsort.h
+ *  @brief Function prototypes for running a sorted query within a memory budget.
+ *
+ */
+#ifndef _EXTSORT_H_
+#define _EXTSORT_H_
+
+#include <stddef.h>
+#include "output.h"
+#include "scan.h"
+#include "sort.h"
+
+/**
+ * @brief The most runs merged at once; more runs are merged in several passes.
+ */
+#define EXTSORT_FAN_IN 64
+
+/**
+ * @brief The most runs kept open while reading; reaching it triggers a merge pass.
+ * Both limits are lowered to fit in half of the process's file descriptor limit.
+ */
+#define EXTSORT_MAX_RUNS 512
+
+/**
+ * @brief The smallest memory budget; at this size the read, run and output
+ * buffers take about 1.6 MB of it (see external_sort_query).
+ */
+#define EXTSORT_MIN_MEMORY (2 * 1024 * 1024)
+
+/**
+ * @brief The smallest read-ahead buffer of the input; each of the two takes a
+ * sixteenth of the budget, up to READER_BUFFER_SIZE.
+ */
+#define EXTSORT_MIN_READ_BUFFER (64 * 1024)
+
+/**
+ * Function protypes associated with the external sort.
+ *
+ */
+size_t parse_memory_size(const char *text);
+void external_sort_query(const char *path, const filter_expr *filter, const char *order_by, const char *order,
+                         const char *limit, size_t memory_limit, sort_algorithm algorithm, output_format format);
+
+#endif
@@ -0,0 +1,90 @@
+/** @file losertree.c
+ *  @brief Implementation of losertree.h
+ *
+ * The tree is stored like a heap: internal node i has children 2i and 2i+1,
+ * and source s is the leaf k + s. This shape works for any k >= 1.
+ */
+#include <stdlib.h>
+#include "emalloc.h"
+#include "losertree.h"
+
+/**
+ * @brief Plays the matches below `node`, records their losers and returns the winner.
+ */
+static int play(loser_tree *tree, int node)
+{
+    if (node >= tree->k)
+    {
+        return node - tree->k;
+    }
+    int left = play(tree, 2 * node);
+    int right = play(tree, 2 * node + 1);
+    if (tree->less(right, left, tree->context))
+    {
+        tree->nodes[node] = left;
+        return right;
+    }
+    tree->nodes[node] = right;
+    return left;
+}
+
+/**
+ * @brief Builds a loser tree over the current elements of k sources.
+ *
+ * @param k The number of sources (at least 1).
+ * @param less The comparison of two sources' current elements.
+ * @param context Passed to `less`.
+ * @return loser_tree* The tree.
+ */
+loser_tree *new_loser_tree(int k, loser_less less, void *context)
+{
+    loser_tree *tree = (loser_tree *)emalloc(sizeof(loser_tree));
+    tree->k = k;
+    tree->nodes = (int *)emalloc(k * sizeof(int));
+    tree->less = less;
+    tree->context = context;
+    tree->nodes[0] = play(tree, 1);
+    return tree;
+}
+
+/**
+ * @brief Returns the source holding the smallest current element.
+ *
+ * @param tree The tree.
+ * @return int The winning source.
+ */
+int loser_tree_winner(const loser_tree *tree)
+{
+    return tree->nodes[0];
+}
+
+/**
+ * @brief Restores the tree after the winning source has advanced to its next element.
+ *
+ * @param tree The tree.
+ */
+void loser_tree_replay(loser_tree *tree)
+{
+    int winner = tree->nodes[0];
+    for (int node = (winner + tree->k) / 2; node >= 1; node /= 2)
+    {
+        if (tree->less(tree->nodes[node], winner, tree->context))
+        {
+            int loser = winner;
+            winner = tree->nodes[node];
+            tree->nodes[node] = loser;
+        }
+    }
+    tree->nodes[0] = winner;
+}
+
+/**
+ * @brief Frees a loser tree.
+ *
+ * @param tree The tree.
+ */
+void free_loser_tree(loser_tree *tree)
+{
+    free(tree->nodes);
+    free(tree);
+}
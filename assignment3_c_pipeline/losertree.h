@@ -0,0 +1,43 @@
+/** @file losertree.h
+ *  @brief Function prototypes for a tournament (loser) tree used in k-way merges.
+ *
+ * The tree tracks which of k sorted sources holds the smallest current
+ * element. After the winner's source advances, loser_tree_replay restores
+ * the invariant with one comparison per level (log2 k), instead of the two
+ * per level a binary heap needs.
+ */
+#ifndef _LOSERTREE_H_
+#define _LOSERTREE_H_
+
+/**
+ * @brief Tells whether the current element of source `a` comes before that of source `b`.
+ *
+ * Must be a strict total order over the sources: exhausted sources come after
+ * every other one, and equal elements should be ordered by source index so the
+ * merge is stable.
+ */
+typedef int (*loser_less)(int a, int b, void *context);
+
+/**
+ * @brief An struct that represents a loser tree over k sources.
+ *
+ * `nodes[1..k-1]` hold the loser of each internal match and `nodes[0]` the overall winner.
+ */
+typedef struct
+{
+    int k;
+    int *nodes;
+    loser_less less;
+    void *context;
+} loser_tree;
+
+/**
+ * Function protypes associated with the loser tree.
+ *
+ */
+loser_tree *new_loser_tree(int k, loser_less less, void *context);
+int loser_tree_winner(const loser_tree *tree);
+void loser_tree_replay(loser_tree *tree);
+void free_loser_tree(loser_tree *tree);
+
+#endif
@@ -0,0 +1,214 @@
+/** @file output.c
+ *  @brief Implementation of output.h
+ *
+ */
+#include <stddef.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "emalloc.h"
+#include "functions.h"
+#include "output.h"
+#include "rowfile.h"
+#include "section.h"
+#include "sort.h"
+
+/**
+ * @brief Moves `used` bytes of a buffer into a new one of `size` bytes.
+ */
+static void *grow(void *data, size_t used, size_t size)
+{
+    void *grown = emalloc(size);
+    if (used > 0)
+    {
+        memcpy(grown, data, used);
+    }
+    free(data);
+    return grown;
+}
+
+/**
+ * @brief Converts the "--output_format" argument into a format.
+ *
+ * @param name "CSV", "BINARY" or "COLUMNAR"; NULL means CSV.
+ * @return output_format The format.
+ */
+output_format parse_output_format(const char *name)
+{
+    if (name == NULL || strcmp(name, "CSV") == 0)
+    {
+        return OUTPUT_CSV;
+    }
+    if (strcmp(name, "BINARY") == 0)
+    {
+        return OUTPUT_BINARY;
+    }
+    if (strcmp(name, "COLUMNAR") == 0)
+    {
+        return OUTPUT_COLUMNAR;
+    }
+    fprintf(stderr, "unknown output format: %s\n", name);
+    exit(1);
+}
+
+/**
+ * @brief Fills the header of a binary or columnar output file.
+ */
+static void fill_header(const output_writer *out, output_header *header)
+{
+    static const char *value_names[] = {"", "streams", "in_spotify_playlists", "in_apple_playlists"};
+    memset(header, 0, sizeof(*header));
+    strcpy(header->magic, out->format == OUTPUT_BINARY ? OUTPUT_ROWS_MAGIC : OUTPUT_COLS_MAGIC);
+    header->version = OUTPUT_VERSION;
+    header->rows = out->rows;
+    header->heap_size = out->heap_size;
+    strcpy(header->value_name, value_names[parse_order_by(out->order_by) + 1]);
+}
+
+/**
+ * @brief Creates the output file of a format and writes what precedes the rows.
+ *
+ * The file is written through a buffer of OUTPUT_BUFFER_SIZE bytes, so rows
+ * reach the disk in large sequential writes.
+ *
+ * @param format The format.
+ * @param order_by The field whose value is written with each row, or NULL for none.
+ * @return output_writer* The output, to be closed with close_output.
+ */
+output_writer *open_output(output_format format, const char *order_by)
+{
+    static const char *paths[] = {"output.csv", "output.rows", "output.cols"};
+    output_writer *out = (output_writer *)emalloc(sizeof(output_writer));
+    memset(out, 0, sizeof(*out));
+    out->format = format;
+    out->order_by = order_by;
+    out->file = fopen(paths[format], "wb");
+    if (out->file == NULL)
+    {
+        perror(paths[format]);
+        exit(1);
+    }
+    out->buffer = (char *)emalloc(OUTPUT_BUFFER_SIZE);
+    setvbuf(out->file, out->buffer, _IOFBF, OUTPUT_BUFFER_SIZE);
+
+    if (format == OUTPUT_CSV)
+    {
+        write_csv_header(out->file, order_by);
+    }
+    else if (format == OUTPUT_BINARY)
+    {
+        // the row count is filled in by close_output
+        output_header header;
+        fill_header(out, &header);
+        fwrite(&header, sizeof(header), 1, out->file);
+    }
+    return out;
+}
+
+/**
+ * @brief Appends a name to the string heap of a columnar output.
+ *
+ * @return uint32_t The offset of the name in the heap.
+ */
+static uint32_t add_to_heap(output_writer *out, const char *name)
+{
+    size_t length = strlen(name) + 1;
+    if (out->heap_size + length > UINT32_MAX)
+    {
+        fprintf(stderr, "output.cols: string heap exceeds 4 GB\n");
+        exit(1);
+    }
+    if (out->heap_size + length > out->heap_capacity)
+    {
+        uint64_t capacity = out->heap_capacity > 0 ? out->heap_capacity : 4096;
+        while (capacity < out->heap_size + length)
+        {
+            capacity *= 2;
+        }
+        out->heap = (char *)grow(out->heap, out->heap_size, capacity);
+        out->heap_capacity = capacity;
+    }
+    uint32_t offset = out->heap_size;
+    memcpy(out->heap + offset, name, length);
+    out->heap_size += length;
+    return offset;
+}
+
+/**
+ * @brief Writes one row to an output.
+ *
+ * @param out The output.
+ * @param row The row; its names only need to stay valid until this returns.
+ */
+void output_row(output_writer *out, const song_row *row)
+{
+    if (out->format == OUTPUT_CSV)
+    {
+        write_csv_row(out->file, row, out->order_by);
+        out->rows++;
+        return;
+    }
+    if (out->format == OUTPUT_BINARY)
+    {
+        write_song_row(out->file, row);
+        out->rows++;
+        return;
+    }
+
+    if (out->rows == out->capacity)
+    {
+        uint32_t capacity = out->capacity > 0 ? out->capacity * 2 : 1024;
+        size_t used = out->rows;
+        out->released_year = (int32_t *)grow(out->released_year, used * sizeof(int32_t), capacity * sizeof(int32_t));
+        out->released_month = (int32_t *)grow(out->released_month, used * sizeof(int32_t), capacity * sizeof(int32_t));
+        out->released_day = (int32_t *)grow(out->released_day, used * sizeof(int32_t), capacity * sizeof(int32_t));
+        out->value = (int64_t *)grow(out->value, used * sizeof(int64_t), capacity * sizeof(int64_t));
+        out->track_name = (uint32_t *)grow(out->track_name, used * sizeof(uint32_t), capacity * sizeof(uint32_t));
+        out->artists_name = (uint32_t *)grow(out->artists_name, used * sizeof(uint32_t), capacity * sizeof(uint32_t));
+        out->capacity = capacity;
+    }
+    uint32_t i = out->rows++;
+    out->released_year[i] = row->released_year;
+    out->released_month[i] = row->released_month;
+    out->released_day[i] = row->released_day;
+    out->value[i] = row->value;
+    out->track_name[i] = add_to_heap(out, row->track_name);
+    out->artists_name[i] = add_to_heap(out, row->artists_name);
+}
+
+/**
+ * @brief Finishes an output: writes what follows the rows, closes the file and frees the output.
+ *
+ * @param out The output.
+ */
+void close_output(output_writer *out)
+{
+    if (out->format == OUTPUT_BINARY)
+    {
+        fseek(out->file, offsetof(output_header, rows), SEEK_SET);
+        fwrite(&out->rows, sizeof(out->rows), 1, out->file);
+    }
+    else if (out->format == OUTPUT_COLUMNAR)
+    {
+        output_header header;
+        fill_header(out, &header);
+        write_section(out->file, &header, sizeof(header));
+        write_section(out->file, out->released_year, out->rows * sizeof(int32_t));
+        write_section(out->file, out->released_month, out->rows * sizeof(int32_t));
+        write_section(out->file, out->released_day, out->rows * sizeof(int32_t));
+        write_section(out->file, out->value, out->rows * sizeof(int64_t));
+        write_section(out->file, out->track_name, out->rows * sizeof(uint32_t));
+        write_section(out->file, out->artists_name, out->rows * sizeof(uint32_t));
+        write_section(out->file, out->heap, out->heap_size);
+    }
+    fclose(out->file);
+    free(out->buffer);
+    free(out->released_year);
+    free(out->released_month);
+    free(out->released_day);
+    free(out->value);
+    free(out->track_name);
+    free(out->artists_name);
+    free(out->heap);
+    free(out);
+}
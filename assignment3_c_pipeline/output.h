@@ -0,0 +1,92 @@
+/** @file output.h
+ *  @brief Function prototypes for writing the result rows in the "--output_format" formats.
+ *
+ * CSV (the default) writes "output.csv". The two binary formats are meant
+ * to be mapped into memory by downstream tools and used without parsing;
+ * both start with an output_header:
+ *
+ * BINARY writes "output.rows": the header followed by one length-prefixed
+ * record per row, in the row file format (see rowfile.h).
+ *
+ * COLUMNAR writes "output.cols": the header followed by
+ *
+ *     released_year  int32[rows]
+ *     released_month int32[rows]
+ *     released_day   int32[rows]
+ *     value          int64[rows]   the "--order_by" field (0 without one)
+ *     track_name     uint32[rows]  offsets into the string heap
+ *     artists_name   uint32[rows]  offsets into the string heap
+ *     heap           NUL-terminated strings, heap_size bytes
+ *
+ * Every section starts at a multiple of 8 bytes. Values are stored in the
+ * byte order of the machine that wrote the file.
+ */
+#ifndef _OUTPUT_H_
+#define _OUTPUT_H_
+
+#include <stdint.h>
+#include <stdio.h>
+#include "rowfile.h"
+
+#define OUTPUT_ROWS_MAGIC "OUTROWS"
+#define OUTPUT_COLS_MAGIC "OUTCOLS"
+#define OUTPUT_VERSION 1
+#define OUTPUT_BUFFER_SIZE (1 << 20)
+
+/**
+ * @brief The formats "--output_format" selects.
+ */
+typedef enum
+{
+    OUTPUT_CSV,
+    OUTPUT_BINARY,
+    OUTPUT_COLUMNAR
+} output_format;
+
+/**
+ * @brief An struct that represents the header at the start of a binary or columnar output file.
+ */
+typedef struct
+{
+    char magic[8];
+    uint32_t version;
+    uint32_t rows;
+    uint64_t heap_size;
+    char value_name[24];
+} output_header;
+
+/**
+ * @brief An struct that holds an output file being written.
+ *
+ * The columnar format collects the columns in memory and writes them when
+ * the output is closed.
+ */
+typedef struct
+{
+    output_format format;
+    const char *order_by;
+    FILE *file;
+    char *buffer;
+    uint32_t rows;
+    uint32_t capacity;
+    int32_t *released_year;
+    int32_t *released_month;
+    int32_t *released_day;
+    int64_t *value;
+    uint32_t *track_name;
+    uint32_t *artists_name;
+    char *heap;
+    uint64_t heap_size;
+    uint64_t heap_capacity;
+} output_writer;
+
+/**
+ * Function protypes associated with the output formats.
+ *
+ */
+output_format parse_output_format(const char *name);
+output_writer *open_output(output_format format, const char *order_by);
+void output_row(output_writer *out, const song_row *row);
+void close_output(output_writer *out);
+
+#endif
@@ -0,0 +1,214 @@
+/** @file pipeline.c
+ *  @brief Implementation of pipeline.h
+ *
+ * A streaming query (one that keeps the input order) runs as four stages,
+ * each on its own thread:
+ *
+ *   read -> parse -> filter -> write
+ *
+ * The calling thread writes and the other three stages are long-running
+ * tasks of the task pool, so the pipeline takes PIPELINE_THREADS of the
+ * "--threads" threads.
+ *
+ * The stages pass batches of rows through bounded single-producer/
+ * single-consumer rings (ring.h), so reading the file, parsing the lines,
+ * evaluating the filter and formatting the output overlap. A full ring
+ * blocks the stage that feeds it, which bounds the memory in flight to
+ * about PIPELINE_RING_SIZE batches per stage. The end of the input is a
+ * NULL batch that every stage forwards before it exits.
+ *
+ * A stage task never waits for other tasks (a batch is smaller than a
+ * filter block, so the filter stage filters it on its own thread), so it
+ * cannot pick up another stage while it waits.
+ */
+#include <stdio.h>
+#include <stdlib.h>
+#include "emalloc.h"
+#include "functions.h"
+#include "list.h"
+#include "output.h"
+#include "pipeline.h"
+#include "pool.h"
+#include "reader.h"
+#include "ring.h"
+#include "rowfile.h"
+#include "scan.h"
+#include "sort.h"
+#include "stats.h"
+#include "table.h"
+
+/**
+ * @brief An struct that represents a batch of rows as it moves through the stages.
+ */
+typedef struct
+{
+    node_t *lines;
+    song_table *table;
+    int *rows;
+    int count;
+} pipeline_batch;
+
+/**
+ * @brief An struct that holds what a stage works on and what it measured.
+ */
+typedef struct
+{
+    line_reader *reader;
+    spsc_ring *in;
+    spsc_ring *out;
+    const filter_expr *filter;
+    unsigned int columns;
+    int *stop;
+    long long rows;
+    double seconds;
+} pipeline_stage;
+
+/**
+ * @brief The read stage: reads batches of lines until the end of the file or until the writer stops.
+ */
+static void read_stage(void *arg)
+{
+    pipeline_stage *stage = (pipeline_stage *)arg;
+    while (!__atomic_load_n(stage->stop, __ATOMIC_ACQUIRE))
+    {
+        double start = stats_now();
+        node_t *lines = read_line_chunk(stage->reader, PIPELINE_BATCH_BYTES, NULL);
+        stage->seconds += stats_now() - start;
+        if (lines == NULL)
+        {
+            break;
+        }
+        pipeline_batch *batch = (pipeline_batch *)emalloc(sizeof(pipeline_batch));
+        batch->lines = lines;
+        batch->table = NULL;
+        batch->rows = NULL;
+        batch->count = 0;
+        ring_push(stage->out, batch);
+    }
+    ring_push(stage->out, NULL);
+}
+
+/**
+ * @brief The parse stage: parses the filter columns of each batch of lines.
+ */
+static void parse_stage(void *arg)
+{
+    pipeline_stage *stage = (pipeline_stage *)arg;
+    pipeline_batch *batch;
+    while ((batch = (pipeline_batch *)ring_pop(stage->in)) != NULL)
+    {
+        double start = stats_now();
+        batch->table = table_from_list(batch->lines, stage->columns);
+        batch->lines = NULL;
+        stage->rows += batch->table->rows;
+        stage->seconds += stats_now() - start;
+        ring_push(stage->out, batch);
+    }
+    ring_push(stage->out, NULL);
+}
+
+/**
+ * @brief The filter stage: selects the rows of each batch that match the filter.
+ */
+static void filter_stage(void *arg)
+{
+    pipeline_stage *stage = (pipeline_stage *)arg;
+    pipeline_batch *batch;
+    while ((batch = (pipeline_batch *)ring_pop(stage->in)) != NULL)
+    {
+        double start = stats_now();
+        batch->rows = filter_table(batch->table, stage->filter, &batch->count);
+        stage->rows += batch->count;
+        stage->seconds += stats_now() - start;
+        ring_push(stage->out, batch);
+    }
+    ring_push(stage->out, NULL);
+}
+
+/**
+ * @brief Runs a filter query that keeps the input order, writing the output as the rows stream in.
+ *
+ * Produces the same output as the in-memory path of main for a query
+ * without "--order_by" and "--order=DES". The caller checks that the pool
+ * has PIPELINE_THREADS threads.
+ *
+ * @param path The csv file.
+ * @param filter The filter, or NULL.
+ * @param limit The most rows to write, or NULL.
+ * @param format The format of the output.
+ */
+void pipeline_query(const char *path, const filter_expr *filter, const char *limit, output_format format)
+{
+    long remaining = limit != NULL ? atol(limit) : -1;
+    if (remaining < -1)
+    {
+        remaining = 0;
+    }
+    int stop = remaining == 0;
+
+    spsc_ring *lines = new_ring(PIPELINE_RING_SIZE);
+    spsc_ring *tables = new_ring(PIPELINE_RING_SIZE);
+    spsc_ring *selections = new_ring(PIPELINE_RING_SIZE);
+
+    pipeline_stage reader = {open_reader(path), NULL, lines, NULL, 0, &stop, 0, 0};
+    pipeline_stage parser = {NULL, lines, tables, NULL, filter_columns(filter), &stop, 0, 0};
+    pipeline_stage selector = {NULL, tables, selections, filter, 0, &stop, 0, 0};
+
+    // the idle workers take one stage each
+    task_group stages = TASK_GROUP_INIT;
+    pool_submit(&stages, read_stage, &reader);
+    pool_submit(&stages, parse_stage, &parser);
+    pool_submit(&stages, filter_stage, &selector);
+
+    // the write stage runs on this thread; once the limit is reached it
+    // stops the reader and only drains the batches still in flight
+    output_writer *output = open_output(format, NULL);
+    double output_seconds = 0;
+    pipeline_batch *batch;
+    while ((batch = (pipeline_batch *)ring_pop(selections)) != NULL)
+    {
+        double start = stats_now();
+        int count = batch->count;
+        if (remaining >= 0 && count > remaining)
+        {
+            count = (int)remaining;
+        }
+        table_materialize(batch->table, COL_OUTPUT, batch->rows, count);
+        for (int i = 0; i < count; i++)
+        {
+            song_row row;
+            table_row(batch->table, batch->rows[i], ORDER_NONE, &row);
+            output_row(output, &row);
+        }
+        if (remaining >= 0)
+        {
+            remaining -= count;
+            if (remaining == 0)
+            {
+                __atomic_store_n(&stop, 1, __ATOMIC_RELEASE);
+            }
+        }
+        free(batch->rows);
+        free_table(batch->table);
+        free(batch);
+        output_seconds += stats_now() - start;
+    }
+    close_output(output);
+
+    // the statistics of the stages (such as the scans) reach this thread
+    pool_wait(&stages);
+    close_reader(reader.reader);
+
+    // the stages overlap, so these are the busy times of each stage's thread
+    stats.rows_loaded = parser.rows;
+    stats.rows_selected = selector.rows;
+    stats.load_seconds = reader.seconds + parser.seconds;
+    stats.filter_seconds = selector.seconds;
+    stats.output_seconds = output_seconds;
+    stats.pipeline_full_waits = lines->full_waits + tables->full_waits + selections->full_waits;
+    stats.pipeline_empty_waits = lines->empty_waits + tables->empty_waits + selections->empty_waits;
+
+    free_ring(lines);
+    free_ring(tables);
+    free_ring(selections);
+}
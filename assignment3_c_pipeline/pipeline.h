@@ -0,0 +1,32 @@
+/** @file pipeline.h
+ *  @brief Function prototypes for running a streaming query as a pipeline of threads.
+ *
+ */
+#ifndef _PIPELINE_H_
+#define _PIPELINE_H_
+
+#include "output.h"
+#include "scan.h"
+
+/**
+ * @brief The number of bytes of lines read into one batch.
+ */
+#define PIPELINE_BATCH_BYTES (256 * 1024)
+
+/**
+ * @brief The most batches waiting between two stages.
+ */
+#define PIPELINE_RING_SIZE 8
+
+/**
+ * @brief The threads the pipeline runs on: three stage tasks and the writing thread.
+ */
+#define PIPELINE_THREADS 4
+
+/**
+ * Function protypes associated with the pipeline.
+ *
+ */
+void pipeline_query(const char *path, const filter_expr *filter, const char *limit, output_format format);
+
+#endif
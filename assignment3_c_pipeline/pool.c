@@ -0,0 +1,356 @@
+/** @file pool.c
+ *  @brief Implementation of pool.h
+ *
+ * Every deque has its own lock, taken briefly by its owner and by thieves;
+ * tasks are coarse (thousands of rows each), so the locks are rarely
+ * contended. Threads with nothing to run sleep on one condition variable,
+ * which is signalled when a task is queued and broadcast when the last task
+ * of a group finishes.
+ */
+#include <pthread.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+#include "emalloc.h"
+#include "pool.h"
+#include "stats.h"
+
+/**
+ * @brief The number of tasks a deque holds before it grows.
+ */
+#define DEQUE_INITIAL_CAPACITY 64
+
+/**
+ * @brief An struct that represents a queued task.
+ */
+typedef struct
+{
+    task_function function;
+    void *arg;
+    task_group *group;
+} task;
+
+/**
+ * @brief An struct that represents the deque of one thread of the pool.
+ *
+ * The tasks are `tasks[top % capacity]` (the oldest) to
+ * `tasks[(bottom - 1) % capacity]` (the newest). Each deque takes its own
+ * cache line so that threads do not invalidate each other's.
+ */
+typedef struct
+{
+    pthread_mutex_t lock;
+    task *tasks;
+    long top;
+    long bottom;
+    long capacity;
+    char pad[64];
+} task_deque;
+
+/**
+ * @brief The pool: its threads, their deques and what the sleeping threads wait on.
+ *
+ * `queued` counts the tasks in all the deques. `totals` collects the
+ * statistics of the workers when they exit.
+ */
+static struct
+{
+    int threads;
+    task_deque *deques;
+    pthread_t *ids;
+    int queued;
+    int stopping;
+    pthread_mutex_t idle_lock;
+    pthread_cond_t wake;
+    stats_t totals;
+} pool = {1, NULL, NULL, 0, 0, PTHREAD_MUTEX_INITIALIZER, PTHREAD_COND_INITIALIZER, {0}};
+
+/**
+ * @brief The deque of the calling thread; threads outside the pool use the first one.
+ */
+static __thread int self = 0;
+
+/**
+ * @brief Pushes a task at the bottom of a deque, growing it when it is full.
+ */
+static void push_bottom(task_deque *deque, const task *t)
+{
+    pthread_mutex_lock(&deque->lock);
+    long size = deque->bottom - deque->top;
+    if (size == deque->capacity)
+    {
+        task *tasks = (task *)emalloc(2 * deque->capacity * sizeof(task));
+        for (long i = 0; i < size; i++)
+        {
+            tasks[i] = deque->tasks[(deque->top + i) % deque->capacity];
+        }
+        free(deque->tasks);
+        deque->tasks = tasks;
+        deque->capacity *= 2;
+        __atomic_store_n(&deque->top, 0, __ATOMIC_RELAXED);
+        __atomic_store_n(&deque->bottom, size, __ATOMIC_RELAXED);
+    }
+    deque->tasks[deque->bottom % deque->capacity] = *t;
+    __atomic_store_n(&deque->bottom, deque->bottom + 1, __ATOMIC_RELAXED);
+    pthread_mutex_unlock(&deque->lock);
+}
+
+/**
+ * @brief Takes a task from a deque: the newest one for its owner, the oldest one for a thief.
+ *
+ * @return int 1 if a task was taken, 0 if the deque was empty.
+ */
+static int take_from(task_deque *deque, int steal, task *t)
+{
+    // a deque that looks empty is skipped without taking its lock
+    if (__atomic_load_n(&deque->bottom, __ATOMIC_RELAXED) <= __atomic_load_n(&deque->top, __ATOMIC_RELAXED))
+    {
+        return 0;
+    }
+    int taken = 0;
+    pthread_mutex_lock(&deque->lock);
+    if (deque->bottom > deque->top)
+    {
+        if (steal)
+        {
+            *t = deque->tasks[deque->top % deque->capacity];
+            __atomic_store_n(&deque->top, deque->top + 1, __ATOMIC_RELAXED);
+        }
+        else
+        {
+            __atomic_store_n(&deque->bottom, deque->bottom - 1, __ATOMIC_RELAXED);
+            *t = deque->tasks[deque->bottom % deque->capacity];
+        }
+        taken = 1;
+    }
+    pthread_mutex_unlock(&deque->lock);
+    if (taken)
+    {
+        __atomic_sub_fetch(&pool.queued, 1, __ATOMIC_RELEASE);
+    }
+    return taken;
+}
+
+/**
+ * @brief Takes a task for the calling thread: from its own deque, or else stolen from the next ones.
+ *
+ * @return int 1 if a task was taken, 0 if every deque was empty.
+ */
+static int take_task(task *t)
+{
+    if (take_from(&pool.deques[self], 0, t))
+    {
+        return 1;
+    }
+    for (int i = 1; i < pool.threads; i++)
+    {
+        if (take_from(&pool.deques[(self + i) % pool.threads], 1, t))
+        {
+            stats.pool_steals++;
+            return 1;
+        }
+    }
+    return 0;
+}
+
+/**
+ * @brief Wakes the threads that sleep in the pool.
+ *
+ * @param all Whether to wake all of them, or just one to run a new task.
+ */
+static void wake_threads(int all)
+{
+    pthread_mutex_lock(&pool.idle_lock);
+    if (all)
+    {
+        pthread_cond_broadcast(&pool.wake);
+    }
+    else
+    {
+        pthread_cond_signal(&pool.wake);
+    }
+    pthread_mutex_unlock(&pool.idle_lock);
+}
+
+/**
+ * @brief Runs a task and marks it finished in its group.
+ *
+ * The statistics the task collects go to its group, not to the thread that
+ * happens to run it, so that they reach the thread that waits for it.
+ */
+static void run_task(const task *t)
+{
+    task_group *group = t->group;
+    stats_t outer = stats;
+    memset(&stats, 0, sizeof(stats));
+    t->function(t->arg);
+    stats_merge(&group->stats, &stats);
+    stats = outer;
+    stats.pool_tasks++;
+    if (__atomic_sub_fetch(&group->pending, 1, __ATOMIC_ACQ_REL) == 0)
+    {
+        wake_threads(1);
+    }
+}
+
+/**
+ * @brief A worker thread: runs tasks until the pool stops.
+ */
+static void *worker_main(void *arg)
+{
+    self = (int)(intptr_t)arg;
+    while (1)
+    {
+        task t;
+        if (take_task(&t))
+        {
+            run_task(&t);
+            continue;
+        }
+
+        double start = stats_now();
+        pthread_mutex_lock(&pool.idle_lock);
+        while (!pool.stopping && __atomic_load_n(&pool.queued, __ATOMIC_ACQUIRE) == 0)
+        {
+            pthread_cond_wait(&pool.wake, &pool.idle_lock);
+        }
+        int stop = pool.stopping && __atomic_load_n(&pool.queued, __ATOMIC_ACQUIRE) == 0;
+        pthread_mutex_unlock(&pool.idle_lock);
+        stats.pool_idle_seconds += stats_now() - start;
+        if (stop)
+        {
+            break;
+        }
+    }
+    stats_merge(&pool.totals, &stats);
+    return NULL;
+}
+
+/**
+ * @brief Starts the pool: the calling thread and `threads` - 1 workers.
+ *
+ * @param threads The most threads the stages run on ("--threads"); 1 runs every task on the submitting thread.
+ */
+void pool_start(int threads)
+{
+    pool.threads = threads > 1 ? threads : 1;
+    pool.queued = 0;
+    pool.stopping = 0;
+    memset(&pool.totals, 0, sizeof(pool.totals));
+    if (pool.threads == 1)
+    {
+        return;
+    }
+
+    pool.deques = (task_deque *)emalloc(pool.threads * sizeof(task_deque));
+    for (int i = 0; i < pool.threads; i++)
+    {
+        pthread_mutex_init(&pool.deques[i].lock, NULL);
+        pool.deques[i].tasks = (task *)emalloc(DEQUE_INITIAL_CAPACITY * sizeof(task));
+        pool.deques[i].top = 0;
+        pool.deques[i].bottom = 0;
+        pool.deques[i].capacity = DEQUE_INITIAL_CAPACITY;
+    }
+    self = 0;
+    pool.ids = (pthread_t *)emalloc(pool.threads * sizeof(pthread_t));
+    for (int i = 1; i < pool.threads; i++)
+    {
+        pthread_create(&pool.ids[i], NULL, worker_main, (void *)(intptr_t)i);
+    }
+}
+
+/**
+ * @brief Stops the pool once its tasks are done, adding the statistics of its workers to the caller's.
+ */
+void pool_stop(void)
+{
+    if (pool.ids != NULL)
+    {
+        pthread_mutex_lock(&pool.idle_lock);
+        pool.stopping = 1;
+        pthread_cond_broadcast(&pool.wake);
+        pthread_mutex_unlock(&pool.idle_lock);
+        for (int i = 1; i < pool.threads; i++)
+        {
+            pthread_join(pool.ids[i], NULL);
+        }
+        for (int i = 0; i < pool.threads; i++)
+        {
+            pthread_mutex_destroy(&pool.deques[i].lock);
+            free(pool.deques[i].tasks);
+        }
+        free(pool.deques);
+        free(pool.ids);
+        pool.deques = NULL;
+        pool.ids = NULL;
+        stats_merge(&stats, &pool.totals);
+    }
+    stats.pool_threads = pool.threads;
+    pool.threads = 1;
+}
+
+/**
+ * @brief Returns the number of threads of the pool, for splitting work into tasks.
+ *
+ * @return int "--threads", or 1 when the pool is not started.
+ */
+int pool_threads(void)
+{
+    return pool.threads;
+}
+
+/**
+ * @brief Submits a task to the pool.
+ *
+ * The task goes to the bottom of the calling thread's deque; with a single
+ * thread it runs right away.
+ *
+ * @param group The group the task belongs to.
+ * @param function The function of the task.
+ * @param arg The argument it is called with.
+ */
+void pool_submit(task_group *group, task_function function, void *arg)
+{
+    task t = {function, arg, group};
+    __atomic_add_fetch(&group->pending, 1, __ATOMIC_RELAXED);
+    if (pool.threads == 1)
+    {
+        run_task(&t);
+        return;
+    }
+    push_bottom(&pool.deques[self], &t);
+    __atomic_add_fetch(&pool.queued, 1, __ATOMIC_RELEASE);
+    wake_threads(0);
+}
+
+/**
+ * @brief Waits until every task of a group has finished, running queued tasks meanwhile.
+ *
+ * The statistics of the group's tasks are then added to the caller's.
+ *
+ * @param group The group.
+ */
+void pool_wait(task_group *group)
+{
+    while (__atomic_load_n(&group->pending, __ATOMIC_ACQUIRE) > 0)
+    {
+        task t;
+        if (take_task(&t))
+        {
+            run_task(&t);
+            continue;
+        }
+
+        double start = stats_now();
+        pthread_mutex_lock(&pool.idle_lock);
+        while (__atomic_load_n(&group->pending, __ATOMIC_ACQUIRE) > 0 &&
+               __atomic_load_n(&pool.queued, __ATOMIC_ACQUIRE) == 0)
+        {
+            pthread_cond_wait(&pool.wake, &pool.idle_lock);
+        }
+        pthread_mutex_unlock(&pool.idle_lock);
+        stats.pool_idle_seconds += stats_now() - start;
+    }
+    stats_merge(&stats, &group->stats);
+    memset(&group->stats, 0, sizeof(group->stats));
+}
@@ -0,0 +1,57 @@
+/** @file pool.h
+ *  @brief Function prototypes for the work-stealing task pool that runs the parallel stages.
+ *
+ * One pool of "--threads" threads (the thread that starts it and
+ * "--threads" - 1 workers) runs the parallel work as tasks: the shards, the
+ * filter blocks, the aggregation ranges, the refills of the read-ahead
+ * buffers and the "--pipeline" stages. Nothing else starts a thread, so a
+ * run never has more than "--threads" of them. Parsing and sorting are not
+ * split into tasks; they run on the thread that asks for them. A task that
+ * blocks for long, like a pipeline stage, holds its thread meanwhile.
+ *
+ * Each thread has a deque of tasks: it pushes and pops its own tasks at the
+ * bottom, newest first, and when it has none it steals the oldest task at
+ * the top of another's.
+ *
+ * Tasks are submitted to a group and a thread waits for its group with
+ * pool_wait, running queued tasks (its own or stolen ones) meanwhile, so a
+ * task may itself submit tasks and wait for them. Statistics a task
+ * collects reach the thread that waits for its group. With one thread, or
+ * before pool_start, tasks run as soon as they are submitted, in order, on
+ * the submitting thread.
+ */
+#ifndef _POOL_H_
+#define _POOL_H_
+
+#include "stats.h"
+
+/**
+ * @brief A task: a function called with its argument.
+ */
+typedef void (*task_function)(void *arg);
+
+/**
+ * @brief An struct that represents a group of tasks that are waited for together.
+ *
+ * `pending` counts the tasks not yet finished and `stats` collects what
+ * they did; initialize a group with TASK_GROUP_INIT.
+ */
+typedef struct
+{
+    int pending;
+    stats_t stats;
+} task_group;
+
+#define TASK_GROUP_INIT {0, {0}}
+
+/**
+ * Function protypes associated with the task pool.
+ *
+ */
+void pool_start(int threads);
+void pool_stop(void);
+int pool_threads(void);
+void pool_submit(task_group *group, task_function function, void *arg);
+void pool_wait(task_group *group);
+
+#endif
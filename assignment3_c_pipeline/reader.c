@@ -0,0 +1,508 @@
+/** @file reader.c
+ *  @brief Implementation of reader.h
+ *
+ */
+#include <errno.h>
+#include <fcntl.h>
+#include <pthread.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <unistd.h>
+#include <zlib.h>
+#include "csv.h"
+#include "emalloc.h"
+#include "functions.h"
+#include "list.h"
+#include "pool.h"
+#include "reader.h"
+#include "stats.h"
+
+/**
+ * @brief Reads up to `size` bytes of the file at the reader's offset.
+ *
+ * Only a read error or the end of the file gives a short read.
+ *
+ * @param reader The reader.
+ * @param dest Where to store the bytes.
+ * @param size The number of bytes wanted.
+ * @param error Set to a message on a read error.
+ * @return size_t The number of bytes read.
+ */
+static size_t read_bytes(line_reader *reader, unsigned char *dest, size_t size, const char **error)
+{
+    size_t length = 0;
+    while (length < size)
+    {
+        ssize_t n = pread(reader->fd, dest + length, size - length, reader->offset);
+        if (n < 0 && errno == EINTR)
+        {
+            continue;
+        }
+        if (n <= 0)
+        {
+            if (n < 0)
+            {
+                *error = strerror(errno);
+            }
+            break;
+        }
+        length += n;
+        reader->offset += n;
+    }
+    return length;
+}
+
+/**
+ * @brief Returns the size of the reads of compressed input: READER_INPUT_SIZE, or less for small buffers.
+ */
+static size_t input_size(const line_reader *reader)
+{
+    return reader->buffer_size < READER_INPUT_SIZE ? reader->buffer_size : READER_INPUT_SIZE;
+}
+
+/**
+ * @brief Decompresses up to `size` bytes of a gzip file.
+ *
+ * Concatenated gzip members are decompressed one after the other, like gzip
+ * itself does. Only an error or the end of the file gives a short result.
+ *
+ * @param reader The reader.
+ * @param dest Where to store the decompressed bytes.
+ * @param size The number of bytes wanted.
+ * @param error Set to a message on a read error or corrupt data.
+ * @return size_t The number of bytes decompressed.
+ */
+static size_t inflate_bytes(line_reader *reader, unsigned char *dest, size_t size, const char **error)
+{
+    z_stream *stream = reader->inflater;
+    stream->next_out = dest;
+    stream->avail_out = size;
+    while (stream->avail_out > 0)
+    {
+        if (stream->avail_in == 0)
+        {
+            stream->next_in = reader->compressed;
+            stream->avail_in = read_bytes(reader, reader->compressed, input_size(reader), error);
+            if (stream->avail_in == 0)
+            {
+                if (*error == NULL && reader->in_member)
+                {
+                    *error = "truncated gzip data";
+                }
+                break;
+            }
+        }
+        int result = inflate(stream, Z_NO_FLUSH);
+        reader->in_member = 1;
+        if (result == Z_STREAM_END)
+        {
+            // another member may follow
+            inflateReset(stream);
+            reader->in_member = 0;
+        }
+        else if (result != Z_OK && result != Z_BUF_ERROR)
+        {
+            *error = stream->msg != NULL ? stream->msg : "corrupt gzip data";
+            break;
+        }
+    }
+    size_t length = size - stream->avail_out;
+    reader->bytes_decompressed += length;
+    return length;
+}
+
+/**
+ * @brief Fills the released buffers in file order, until the next one is still in use.
+ *
+ * Only one thread fills at a time, since the buffers take consecutive parts
+ * of the file; a thread that finds another one filling returns at once.
+ * A buffer is only refilled after the reader released it, so at most one
+ * buffer is read (and decompressed) ahead of the one being consumed.
+ *
+ * @param reader The reader.
+ * @param wanted The buffer to stop at once it is full, or NULL to fill all the released ones.
+ */
+static void fill_buffers(line_reader *reader, const read_buffer *wanted)
+{
+    pthread_mutex_lock(&reader->lock);
+    while (!reader->filling && !reader->finished && !reader->stop && !reader->buffers[reader->next_fill].full &&
+           (wanted == NULL || !wanted->full))
+    {
+        read_buffer *buffer = &reader->buffers[reader->next_fill];
+        reader->filling = 1;
+        pthread_mutex_unlock(&reader->lock);
+
+        const char *error = NULL;
+        size_t length;
+        if (reader->inflater != NULL)
+        {
+            length = inflate_bytes(reader, (unsigned char *)buffer->data, reader->buffer_size, &error);
+        }
+        else
+        {
+            length = read_bytes(reader, (unsigned char *)buffer->data, reader->buffer_size, &error);
+        }
+
+        pthread_mutex_lock(&reader->lock);
+        buffer->length = error != NULL ? 0 : length;
+        reader->error = error;
+        reader->finished = buffer->length == 0;
+        reader->next_fill ^= 1;
+        reader->filling = 0;
+        // the reader checks `full` without the lock
+        __atomic_store_n(&buffer->full, 1, __ATOMIC_RELEASE);
+        pthread_cond_broadcast(&reader->changed);
+    }
+    pthread_mutex_unlock(&reader->lock);
+}
+
+/**
+ * @brief A fill task: fills the buffers the reader released.
+ */
+static void fill_task(void *arg)
+{
+    fill_buffers((line_reader *)arg, NULL);
+}
+
+/**
+ * @brief Starts filling the released buffers ahead of the reader on the task pool.
+ *
+ * With a single-threaded pool the buffers are filled when they are needed
+ * instead, so that the read does not happen earlier for nothing.
+ *
+ * @param reader The reader.
+ */
+static void read_ahead(line_reader *reader)
+{
+    if (pool_threads() > 1)
+    {
+        pool_submit(&reader->fills, fill_task, reader);
+    }
+}
+
+/**
+ * @brief Opens a csv file for reading, starts reading it ahead and skips its header line.
+ *
+ * The file may be gzip-compressed; it is then decompressed as it is read.
+ *
+ * An unreadable file ends the program.
+ *
+ * @param path The file to open.
+ * @return line_reader* The reader, positioned at the first song.
+ */
+line_reader *open_reader(const char *path)
+{
+    return open_reader_sized(path, READER_BUFFER_SIZE);
+}
+
+/**
+ * @brief Opens a csv file like open_reader, with read-ahead buffers of a given size.
+ *
+ * Smaller buffers keep the reader within a memory budget (see extsort.c);
+ * records may still be of any length.
+ *
+ * @param path The file to open.
+ * @param buffer_size The size of each of the two buffers, and the most compressed input read at once.
+ * @return line_reader* The reader, positioned at the first song.
+ */
+line_reader *open_reader_sized(const char *path, size_t buffer_size)
+{
+    line_reader *reader = (line_reader *)emalloc(sizeof(line_reader));
+    reader->fd = open(path, O_RDONLY);
+    if (reader->fd < 0)
+    {
+        perror(path);
+        exit(1);
+    }
+    // the file is read once, front to back
+    posix_fadvise(reader->fd, 0, 0, POSIX_FADV_SEQUENTIAL);
+    reader->path = path;
+    reader->buffer_size = buffer_size;
+    reader->offset = 0;
+    reader->bytes_decompressed = 0;
+    reader->in_member = 0;
+    reader->inflater = NULL;
+    reader->compressed = NULL;
+
+    // gzip input is recognized by its magic number and decompressed in memory
+    unsigned char magic[2];
+    if (pread(reader->fd, magic, sizeof(magic), 0) == sizeof(magic) && magic[0] == 0x1f && magic[1] == 0x8b)
+    {
+        reader->inflater = (z_stream *)emalloc(sizeof(z_stream));
+        memset(reader->inflater, 0, sizeof(z_stream));
+        // 15 window bits, +16 for a gzip wrapper
+        if (inflateInit2(reader->inflater, 15 + 16) != Z_OK)
+        {
+            fprintf(stderr, "%s: cannot initialize zlib\n", path);
+            exit(1);
+        }
+        reader->compressed = (unsigned char *)emalloc(input_size(reader));
+    }
+    for (int i = 0; i < 2; i++)
+    {
+        // mapped directly: freeing malloc'd multi-MB blocks raises malloc's
+        // mmap threshold, which made freeing the parsed table much slower
+        reader->buffers[i].data = (char *)mmap(NULL, reader->buffer_size, PROT_READ | PROT_WRITE,
+                                               MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+        if (reader->buffers[i].data == MAP_FAILED)
+        {
+            perror("mmap");
+            exit(1);
+        }
+        reader->buffers[i].length = 0;
+        reader->buffers[i].full = 0;
+    }
+    reader->current = 0;
+    reader->position = 0;
+    reader->stop = 0;
+    reader->error = NULL;
+    reader->next_fill = 0;
+    reader->filling = 0;
+    reader->finished = 0;
+    reader->fills = (task_group)TASK_GROUP_INIT;
+    pthread_mutex_init(&reader->lock, NULL);
+    pthread_cond_init(&reader->changed, NULL);
+    reader->line_capacity = MAX_LINE_LEN;
+    reader->line = (char *)emalloc(reader->line_capacity);
+    reader->line_number = 0;
+    reader->record_line = 0;
+    reader->rejected = 0;
+    read_ahead(reader);
+
+    // skip the header so it is never parsed as a song
+    read_line(reader);
+    return reader;
+}
+
+/**
+ * @brief Waits until the current buffer is filled, filling it on this thread if no task has started on it.
+ *
+ * A read error ends the program.
+ *
+ * @param reader The reader.
+ * @return read_buffer* The buffer; empty at the end of the file.
+ */
+static read_buffer *current_buffer(line_reader *reader)
+{
+    read_buffer *buffer = &reader->buffers[reader->current];
+    if (!__atomic_load_n(&buffer->full, __ATOMIC_ACQUIRE))
+    {
+        fill_buffers(reader, buffer);
+        pthread_mutex_lock(&reader->lock);
+        while (!buffer->full)
+        {
+            pthread_cond_wait(&reader->changed, &reader->lock);
+        }
+        pthread_mutex_unlock(&reader->lock);
+    }
+    // an error is reported as an empty buffer
+    if (buffer->length == 0 && reader->error != NULL)
+    {
+        fprintf(stderr, "%s: %s\n", reader->path, reader->error);
+        exit(1);
+    }
+    return buffer;
+}
+
+/**
+ * @brief Hands the current buffer back to be refilled and moves to the other one.
+ *
+ * @param reader The reader.
+ */
+static void release_buffer(line_reader *reader)
+{
+    pthread_mutex_lock(&reader->lock);
+    reader->buffers[reader->current].full = 0;
+    pthread_cond_broadcast(&reader->changed);
+    pthread_mutex_unlock(&reader->lock);
+    reader->current ^= 1;
+    reader->position = 0;
+    read_ahead(reader);
+}
+
+/**
+ * @brief Appends bytes to the line being assembled, growing it as needed.
+ */
+static void append_to_line(line_reader *reader, size_t *length, const char *bytes, size_t count)
+{
+    if (*length + count + 1 > reader->line_capacity)
+    {
+        while (*length + count + 1 > reader->line_capacity)
+        {
+            reader->line_capacity *= 2;
+        }
+        char *bigger = (char *)emalloc(reader->line_capacity);
+        memcpy(bigger, reader->line, *length);
+        free(reader->line);
+        reader->line = bigger;
+    }
+    memcpy(reader->line + *length, bytes, count);
+    *length += count;
+}
+
+/**
+ * @brief Reads the next csv record of the file.
+ *
+ * A record is a line, or several lines when a quoted field holds newlines.
+ * Records may span the two buffers and have any length. `record_line` is
+ * set to the line number the record starts on.
+ *
+ * @param reader The reader.
+ * @return char* The record, including its newline, valid until the next call; NULL at the end of the file.
+ */
+char *read_line(line_reader *reader)
+{
+    size_t length = 0;
+    size_t line_start = 0;
+    int quoted = 0;
+    reader->record_line = reader->line_number + 1;
+    while (1)
+    {
+        read_buffer *buffer = current_buffer(reader);
+        if (buffer->length == 0)
+        {
+            break;
+        }
+        const char *start = buffer->data + reader->position;
+        size_t available = buffer->length - reader->position;
+        const char *newline = (const char *)memchr(start, '\n', available);
+        size_t count = newline != NULL ? (size_t)(newline - start) + 1 : available;
+        append_to_line(reader, &length, start, count);
+        reader->position += count;
+        if (reader->position == buffer->length)
+        {
+            release_buffer(reader);
+        }
+        if (newline != NULL)
+        {
+            reader->line_number++;
+            // only a field that opened with a quote continues on the next line;
+            // lines without quotes are not scanned
+            const char *line = reader->line + line_start;
+            size_t line_length = length - line_start;
+            if (quoted || memchr(line, '"', line_length) != NULL)
+            {
+                quoted = csv_line_continues(line, line_length, quoted);
+            }
+            if (!quoted)
+            {
+                break;
+            }
+            line_start = length;
+        }
+    }
+
+    if (length == 0)
+    {
+        return NULL;
+    }
+    if (reader->line[length - 1] != '\n')
+    {
+        // the last line of a file without a final newline
+        reader->line_number++;
+    }
+    reader->line[length] = '\0';
+    return reader->line;
+}
+
+/**
+ * @brief Reads songs into a linked list until the end of the file or until the
+ * list holds about `budget` bytes.
+ *
+ * Each record is checked by csv_check_record. Malformed records are skipped
+ * and reported on stderr with their line number (the first READER_MAX_REPORTS
+ * of them; close_reader reports how many there were), and blank lines are
+ * ignored. The size of a line in the list is counted as its length plus the
+ * allocation overhead of its node, so a chunk of a given budget fits in
+ * roughly that much memory.
+ *
+ * @param reader The reader.
+ * @param budget The number of bytes to stop at; the line that crosses it is still read.
+ * @param used Set to the number of bytes the list holds; may be NULL.
+ * @return node_t* The head of the list, or NULL at the end of the file.
+ */
+node_t *read_line_chunk(line_reader *reader, size_t budget, size_t *used)
+{
+    node_t *head = NULL;
+    node_t *tail = NULL;
+    size_t bytes = 0;
+    char *line;
+
+    while (bytes < budget && (line = read_line(reader)) != NULL)
+    {
+        if (line[0] == '\n' || (line[0] == '\r' && line[1] == '\n'))
+        {
+            continue;
+        }
+        size_t length = strlen(line);
+        const char *error = csv_check_record(line, length, COL_NUMBER_OF_FIELDS, 2);
+        if (error != NULL)
+        {
+            if (reader->rejected++ < READER_MAX_REPORTS)
+            {
+                fprintf(stderr, "%s:%ld: malformed row skipped: %s\n", reader->path, reader->record_line, error);
+            }
+            continue;
+        }
+        node_t *new_node = (node_t *)emalloc(sizeof(node_t));
+        new_node->word = strdup(line);
+        new_node->next = NULL;
+        // append through the tail instead of add_end, which walks the whole list
+        if (tail == NULL)
+        {
+            head = new_node;
+        }
+        else
+        {
+            tail->next = new_node;
+        }
+        tail = new_node;
+        bytes += length + 1 + sizeof(node_t);
+    }
+
+    if (used != NULL)
+    {
+        *used = bytes;
+    }
+    return head;
+}
+
+/**
+ * @brief Stops reading ahead, closes a reader and frees it.
+ *
+ * The bytes read from the file are added to the "--stats" counters.
+ *
+ * @param reader The reader.
+ */
+void close_reader(line_reader *reader)
+{
+    pthread_mutex_lock(&reader->lock);
+    reader->stop = 1;
+    pthread_cond_broadcast(&reader->changed);
+    pthread_mutex_unlock(&reader->lock);
+    // a fill task that has not run yet returns as soon as it runs
+    pool_wait(&reader->fills);
+    stats.bytes_read += reader->offset;
+    stats.rows_rejected += reader->rejected;
+    if (reader->rejected > READER_MAX_REPORTS)
+    {
+        fprintf(stderr, "%s: %lld malformed rows skipped\n", reader->path, reader->rejected);
+    }
+    stats.bytes_decompressed += reader->bytes_decompressed;
+    if (reader->inflater != NULL)
+    {
+        inflateEnd(reader->inflater);
+        free(reader->inflater);
+        free(reader->compressed);
+    }
+
+    close(reader->fd);
+    pthread_mutex_destroy(&reader->lock);
+    pthread_cond_destroy(&reader->changed);
+    munmap(reader->buffers[0].data, reader->buffer_size);
+    munmap(reader->buffers[1].data, reader->buffer_size);
+    free(reader->line);
+    free(reader);
+}
@@ -0,0 +1,98 @@
+/** @file reader.h
+ *  @brief Function prototypes for reading the lines of a csv data file.
+ *
+ * The file is read ahead with large pread calls into two alternating
+ * buffers: while the lines of one buffer are handed out, the next one is
+ * being filled by a task of the task pool (pool.h), so parsing does not
+ * stall on every refill. Gzip files are decompressed by the same tasks
+ * straight into the buffers. The reader fills a buffer itself when no task
+ * has started on it yet, which is how a single-threaded pool reads, so
+ * reading never adds a thread beyond "--threads".
+ */
+#ifndef _READER_H_
+#define _READER_H_
+
+#include <pthread.h>
+#include <stddef.h>
+#include <stdio.h>
+#include <sys/types.h>
+#include <zlib.h>
+#include "list.h"
+#include "pool.h"
+
+/**
+ * @brief The size of each of the two read-ahead buffers (see open_reader_sized for smaller ones).
+ */
+#define READER_BUFFER_SIZE (4 * 1024 * 1024)
+
+/**
+ * @brief The most malformed rows reported one by one.
+ */
+#define READER_MAX_REPORTS 10
+
+/**
+ * @brief The size of the reads of compressed input, at most that of a read-ahead buffer.
+ */
+#define READER_INPUT_SIZE (1024 * 1024)
+
+/**
+ * @brief An struct that represents one read-ahead buffer.
+ *
+ * `full` is set by the fill once `length` bytes are in `data`
+ * (0 at the end of the file) and cleared by the reader once it consumed them.
+ */
+typedef struct
+{
+    char *data;
+    size_t length;
+    int full;
+} read_buffer;
+
+/**
+ * @brief An struct that represents an open csv file positioned after its header.
+ *
+ * `offset`, `inflater`, `compressed` and `in_member` belong to the thread
+ * that is filling a buffer (`filling`), which fills `buffers[next_fill]` next;
+ * `inflater` is NULL unless the file is gzip-compressed. `finished` is set
+ * once the end of the file was read, and `fills` is the group of the fill
+ * tasks.
+ */
+typedef struct
+{
+    int fd;
+    const char *path;
+    off_t offset;
+    z_stream *inflater;
+    unsigned char *compressed;
+    int in_member;
+    long long bytes_decompressed;
+    read_buffer buffers[2];
+    size_t buffer_size;
+    int current;
+    size_t position;
+    int stop;
+    const char *error;
+    int next_fill;
+    int filling;
+    int finished;
+    task_group fills;
+    pthread_mutex_t lock;
+    pthread_cond_t changed;
+    char *line;
+    size_t line_capacity;
+    long line_number;
+    long record_line;
+    long long rejected;
+} line_reader;
+
+/**
+ * Function protypes associated with the reader.
+ *
+ */
+line_reader *open_reader(const char *path);
+line_reader *open_reader_sized(const char *path, size_t buffer_size);
+char *read_line(line_reader *reader);
+node_t *read_line_chunk(line_reader *reader, size_t budget, size_t *used);
+void close_reader(line_reader *reader);
+
+#endif
@@ -0,0 +1,172 @@
+/** @file ring.c
+ *  @brief Implementation of ring.h
+ *
+ */
+#include <sched.h>
+#include <stdlib.h>
+#include "emalloc.h"
+#include "ring.h"
+
+/**
+ * @brief How many times a waiting side re-checks the ring before yielding the CPU.
+ */
+#define RING_SPINS 64
+
+/**
+ * @brief How many times a waiting side yields the CPU before it parks.
+ */
+#define RING_YIELDS 64
+
+/**
+ * @brief Creates an empty ring.
+ *
+ * @param capacity The most items the ring holds; rounded up to a power of two.
+ * @return spsc_ring* The ring.
+ */
+spsc_ring *new_ring(size_t capacity)
+{
+    size_t size = 1;
+    while (size < capacity)
+    {
+        size <<= 1;
+    }
+    spsc_ring *ring = (spsc_ring *)emalloc(sizeof(spsc_ring));
+    ring->slots = (void **)emalloc(size * sizeof(void *));
+    ring->mask = size - 1;
+    ring->head = 0;
+    ring->tail = 0;
+    ring->full_waits = 0;
+    ring->empty_waits = 0;
+    ring->producer_parked = 0;
+    ring->consumer_parked = 0;
+    pthread_mutex_init(&ring->lock, NULL);
+    pthread_cond_init(&ring->not_full, NULL);
+    pthread_cond_init(&ring->not_empty, NULL);
+    return ring;
+}
+
+/**
+ * @brief Tells whether the ring is full, as seen by the producer.
+ */
+static int ring_full(spsc_ring *ring, size_t tail)
+{
+    return tail - __atomic_load_n(&ring->head, __ATOMIC_SEQ_CST) > ring->mask;
+}
+
+/**
+ * @brief Tells whether the ring is empty, as seen by the consumer.
+ */
+static int ring_empty(spsc_ring *ring, size_t head)
+{
+    return __atomic_load_n(&ring->tail, __ATOMIC_SEQ_CST) == head;
+}
+
+/**
+ * @brief Waits until the ring is not `blocked` any more: spins, then yields, then parks.
+ *
+ * A parked side first raises its `parked` flag and then checks the ring
+ * again, while the other side first moves its index and then checks the
+ * flag (both sequentially consistent), so one of them always sees the other.
+ *
+ * @param ring The ring.
+ * @param blocked ring_full or ring_empty.
+ * @param index The tail of the producer or the head of the consumer.
+ * @param parked The flag of the waiting side.
+ * @param wake The condition variable the other side signals.
+ */
+static void ring_wait(spsc_ring *ring, int (*blocked)(spsc_ring *, size_t), size_t index, int *parked,
+                      pthread_cond_t *wake)
+{
+    for (int round = 0; blocked(ring, index); round++)
+    {
+        if (round < RING_SPINS)
+        {
+            continue;
+        }
+        if (round < RING_SPINS + RING_YIELDS)
+        {
+            sched_yield();
+            continue;
+        }
+        pthread_mutex_lock(&ring->lock);
+        __atomic_store_n(parked, 1, __ATOMIC_SEQ_CST);
+        while (blocked(ring, index))
+        {
+            pthread_cond_wait(wake, &ring->lock);
+        }
+        __atomic_store_n(parked, 0, __ATOMIC_SEQ_CST);
+        pthread_mutex_unlock(&ring->lock);
+    }
+}
+
+/**
+ * @brief Wakes the other side if it is parked.
+ */
+static void ring_wake(spsc_ring *ring, int *parked, pthread_cond_t *wake)
+{
+    if (__atomic_load_n(parked, __ATOMIC_SEQ_CST))
+    {
+        pthread_mutex_lock(&ring->lock);
+        pthread_cond_signal(wake);
+        pthread_mutex_unlock(&ring->lock);
+    }
+}
+
+/**
+ * @brief Appends an item, waiting while the ring is full.
+ *
+ * Must only be called by the producer.
+ *
+ * @param ring The ring.
+ * @param item The item.
+ */
+void ring_push(spsc_ring *ring, void *item)
+{
+    size_t tail = ring->tail;
+    if (ring_full(ring, tail))
+    {
+        ring->full_waits++;
+        ring_wait(ring, ring_full, tail, &ring->producer_parked, &ring->not_full);
+    }
+    ring->slots[tail & ring->mask] = item;
+    // publish the slot before the new tail
+    __atomic_store_n(&ring->tail, tail + 1, __ATOMIC_SEQ_CST);
+    ring_wake(ring, &ring->consumer_parked, &ring->not_empty);
+}
+
+/**
+ * @brief Removes the oldest item, waiting while the ring is empty.
+ *
+ * Must only be called by the consumer.
+ *
+ * @param ring The ring.
+ * @return void* The item.
+ */
+void *ring_pop(spsc_ring *ring)
+{
+    size_t head = ring->head;
+    if (ring_empty(ring, head))
+    {
+        ring->empty_waits++;
+        ring_wait(ring, ring_empty, head, &ring->consumer_parked, &ring->not_empty);
+    }
+    void *item = ring->slots[head & ring->mask];
+    // release the slot only after it was read
+    __atomic_store_n(&ring->head, head + 1, __ATOMIC_SEQ_CST);
+    ring_wake(ring, &ring->producer_parked, &ring->not_full);
+    return item;
+}
+
+/**
+ * @brief Frees a ring; the items left in it are not freed.
+ *
+ * @param ring The ring.
+ */
+void free_ring(spsc_ring *ring)
+{
+    pthread_mutex_destroy(&ring->lock);
+    pthread_cond_destroy(&ring->not_full);
+    pthread_cond_destroy(&ring->not_empty);
+    free(ring->slots);
+    free(ring);
+}
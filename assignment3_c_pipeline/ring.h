@@ -0,0 +1,59 @@
+/** @file ring.h
+ *  @brief Function prototypes for a bounded single-producer/single-consumer ring buffer.
+ *
+ * One thread pushes and one thread pops; the two only share the head and
+ * tail indices, which are published with acquire/release atomics, so no lock
+ * is taken. A full ring makes the producer wait (backpressure) and an empty
+ * ring makes the consumer wait: a waiting side spins briefly, then yields,
+ * and then parks on a condition variable until the other side wakes it, so
+ * a stalled stage does not keep the others busy. The lock is only taken by
+ * a side that parks or wakes a parked one.
+ */
+#ifndef _RING_H_
+#define _RING_H_
+
+#include <pthread.h>
+#include <stddef.h>
+
+/**
+ * @brief The size of a cache line; the producer and consumer indices are kept
+ * on separate lines so they do not invalidate each other's cache.
+ */
+#define RING_CACHE_LINE 64
+
+/**
+ * @brief An struct that represents a ring of pointers between two threads.
+ *
+ * `tail` is only written by the producer and `head` only by the consumer.
+ * Each side counts how often it had to wait for the other. `producer_parked`
+ * and `consumer_parked` tell the other side to signal `not_full` or
+ * `not_empty`.
+ */
+typedef struct
+{
+    void **slots;
+    size_t mask;
+    char pad0[RING_CACHE_LINE];
+    size_t tail;
+    long long full_waits;
+    char pad1[RING_CACHE_LINE];
+    size_t head;
+    long long empty_waits;
+    char pad2[RING_CACHE_LINE];
+    int producer_parked;
+    int consumer_parked;
+    pthread_mutex_t lock;
+    pthread_cond_t not_full;
+    pthread_cond_t not_empty;
+} spsc_ring;
+
+/**
+ * Function protypes associated with the ring buffer.
+ *
+ */
+spsc_ring *new_ring(size_t capacity);
+void ring_push(spsc_ring *ring, void *item);
+void *ring_pop(spsc_ring *ring);
+void free_ring(spsc_ring *ring);
+
+#endif
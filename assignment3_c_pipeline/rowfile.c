@@ -0,0 +1,134 @@
+/** @file rowfile.c
+ *  @brief Implementation of rowfile.h
+ *
+ */
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "emalloc.h"
+#include "rowfile.h"
+#include "sort.h"
+#include "table.h"
+
+#define ROW_FIXED_SIZE (3 * sizeof(int32_t) + sizeof(int64_t))
+
+/**
+ * @brief Collects the output fields of a table row.
+ *
+ * The names point into the table, so the row is valid as long as the table is.
+ *
+ * @param table The table.
+ * @param row The row id.
+ * @param field The "--order_by" field whose value is stored, or ORDER_NONE.
+ * @param out The row to fill.
+ */
+void table_row(const song_table *table, int row, order_field field, song_row *out)
+{
+    out->released_year = table->released_year[row];
+    out->released_month = table->released_month[row];
+    out->released_day = table->released_day[row];
+    out->value = 0;
+    if (field == ORDER_STREAMS)
+    {
+        out->value = table->streams[row];
+    }
+    else if (field == ORDER_SPOTIFY_PLAYLISTS)
+    {
+        out->value = table->in_spotify_playlists[row];
+    }
+    else if (field == ORDER_APPLE_PLAYLISTS)
+    {
+        out->value = table->in_apple_playlists[row];
+    }
+    out->track_name = table->track_name[row];
+    out->artists_name = table->artists_name[row];
+}
+
+/**
+ * @brief Appends a row to a row file.
+ *
+ * @param file The file to write to.
+ * @param row The row.
+ */
+void write_song_row(FILE *file, const song_row *row)
+{
+    uint32_t track_len = strlen(row->track_name);
+    uint32_t artist_len = strlen(row->artists_name);
+    uint32_t length = ROW_FIXED_SIZE + sizeof(uint32_t) + track_len + sizeof(uint32_t) + artist_len;
+    int32_t date[3] = {row->released_year, row->released_month, row->released_day};
+    int64_t value = row->value;
+
+    fwrite(&length, sizeof(length), 1, file);
+    fwrite(date, sizeof(date), 1, file);
+    fwrite(&value, sizeof(value), 1, file);
+    fwrite(&track_len, sizeof(track_len), 1, file);
+    fwrite(row->track_name, 1, track_len, file);
+    fwrite(&artist_len, sizeof(artist_len), 1, file);
+    fwrite(row->artists_name, 1, artist_len, file);
+}
+
+/**
+ * @brief Reads the next row of a row file.
+ *
+ * The names of the row point into `buffer`, which is grown as needed and
+ * reused by the next call.
+ *
+ * @param file The file to read from.
+ * @param row The row to fill.
+ * @param buffer The buffer to decode into; start with {NULL, 0} and free `data` when done.
+ * @return int 1 if a row was read, 0 at the end of the file, -1 if the file is corrupt.
+ */
+int read_song_row(FILE *file, song_row *row, row_buffer *buffer)
+{
+    uint32_t length;
+    if (fread(&length, sizeof(length), 1, file) != 1)
+    {
+        return 0;
+    }
+    if (length < ROW_FIXED_SIZE + 2 * sizeof(uint32_t))
+    {
+        return -1;
+    }
+    // one extra byte to terminate the artist name
+    if (buffer->capacity < (size_t)length + 1)
+    {
+        free(buffer->data);
+        buffer->capacity = 2 * ((size_t)length + 1);
+        buffer->data = (char *)emalloc(buffer->capacity);
+    }
+    char *data = buffer->data;
+    if (fread(data, 1, length, file) != length)
+    {
+        return -1;
+    }
+
+    int32_t date[3];
+    int64_t value;
+    uint32_t track_len, artist_len;
+    memcpy(date, data, sizeof(date));
+    memcpy(&value, data + sizeof(date), sizeof(value));
+    memcpy(&track_len, data + ROW_FIXED_SIZE, sizeof(track_len));
+    if (track_len > length - ROW_FIXED_SIZE - 2 * sizeof(uint32_t))
+    {
+        return -1;
+    }
+    char *track = data + ROW_FIXED_SIZE + sizeof(uint32_t);
+    memcpy(&artist_len, track + track_len, sizeof(artist_len));
+    if (artist_len != length - ROW_FIXED_SIZE - 2 * sizeof(uint32_t) - track_len)
+    {
+        return -1;
+    }
+    char *artist = track + track_len + sizeof(uint32_t);
+
+    // the artist length has been read, so its first byte can end the track name
+    track[track_len] = '\0';
+    artist[artist_len] = '\0';
+
+    row->released_year = date[0];
+    row->released_month = date[1];
+    row->released_day = date[2];
+    row->value = value;
+    row->track_name = track;
+    row->artists_name = artist;
+    return 1;
+}
@@ -0,0 +1,54 @@
+/** @file rowfile.h
+ *  @brief Function prototypes for the compact binary row format.
+ *
+ * A row file is a sequence of length-prefixed records, one per output row:
+ *
+ *     uint32 length          number of bytes that follow
+ *     int32  released_year
+ *     int32  released_month
+ *     int32  released_day
+ *     int64  value           the "--order_by" field (0 without one)
+ *     uint32 track_len       followed by the track name bytes
+ *     uint32 artist_len      followed by the artist(s) name bytes
+ *
+ * Values are stored in the byte order of the machine that wrote the file.
+ */
+#ifndef _ROWFILE_H_
+#define _ROWFILE_H_
+
+#include <stdint.h>
+#include <stdio.h>
+#include "sort.h"
+#include "table.h"
+
+/**
+ * @brief An struct that represents one output row: the fields write_rows_to_file writes.
+ */
+typedef struct
+{
+    int released_year;
+    int released_month;
+    int released_day;
+    long int value;
+    const char *track_name;
+    const char *artists_name;
+} song_row;
+
+/**
+ * @brief An struct that holds the buffer read_song_row decodes rows into.
+ */
+typedef struct
+{
+    char *data;
+    size_t capacity;
+} row_buffer;
+
+/**
+ * Function protypes associated with row files.
+ *
+ */
+void table_row(const song_table *table, int row, order_field field, song_row *out);
+void write_song_row(FILE *file, const song_row *row);
+int read_song_row(FILE *file, song_row *row, row_buffer *buffer);
+
+#endif
@@ -0,0 +1,821 @@
+/** @file scan.c
+ *  @brief Implementation of scan.h
+ *
+ * The numeric scans process 64 rows per bitmap word. When the compiler
+ * targets AVX2 (e.g. the release build with -march=native) each word is
+ * produced by eight 8-lane (int) or sixteen 4-lane (long) vector compares
+ * whose lane masks are packed with movemask; otherwise a branchless scalar
+ * loop is used. The last, partial word is always handled by the scalar loop.
+ *
+ * The ARTIST filter scans the packed artist names of a table (see
+ * table_pack_artists) as one buffer: AVX2 compares 32 positions at a time
+ * against the first and the last byte of the substring, only positions
+ * where both match are compared in full, and each match is mapped to its
+ * row by walking the row starts forward. Without AVX2 the buffer is
+ * searched with memmem. Names are separated by NULs, which the substring
+ * cannot contain, so no match spans two rows.
+ */
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#ifdef __AVX2__
+#include <immintrin.h>
+#endif
+#include "emalloc.h"
+#include "pool.h"
+#include "scan.h"
+#include "stats.h"
+#include "table.h"
+#include "zonemap.h"
+
+/**
+ * @brief Allocates a bitmap for the given number of rows with every bit cleared.
+ *
+ * @param rows The number of rows the bitmap covers.
+ * @return uint64_t* A pointer to the first word of the bitmap.
+ */
+uint64_t *new_bitmap(int rows)
+{
+    int words = BITMAP_WORDS(rows) > 0 ? BITMAP_WORDS(rows) : 1;
+    uint64_t *bitmap = (uint64_t *)emalloc(words * sizeof(uint64_t));
+    memset(bitmap, 0, words * sizeof(uint64_t));
+    return bitmap;
+}
+
+/**
+ * @brief Compares up to 64 ints against a value, one bit per row (scalar version).
+ */
+static uint64_t scan_int_scalar(const int *column, int n, scan_op op, int value)
+{
+    uint64_t word = 0;
+    for (int j = 0; j < n; j++)
+    {
+        int hit = op == SCAN_EQ ? column[j] == value : (op == SCAN_GE ? column[j] >= value : column[j] <= value);
+        word |= (uint64_t)hit << j;
+    }
+    return word;
+}
+
+/**
+ * @brief Compares up to 64 longs against a value, one bit per row (scalar version).
+ */
+static uint64_t scan_long_scalar(const long int *column, int n, scan_op op, long int value)
+{
+    uint64_t word = 0;
+    for (int j = 0; j < n; j++)
+    {
+        int hit = op == SCAN_EQ ? column[j] == value : (op == SCAN_GE ? column[j] >= value : column[j] <= value);
+        word |= (uint64_t)hit << j;
+    }
+    return word;
+}
+
+/**
+ * @brief Scans an int column and sets the bit of every row where `column[row] OP value` holds.
+ *
+ * Every word of the bitmap is overwritten.
+ *
+ * @param column The column to scan.
+ * @param rows The number of rows in the column.
+ * @param op The comparison to perform.
+ * @param value The value to compare against.
+ * @param bitmap The bitmap to write, BITMAP_WORDS(rows) words long.
+ */
+void scan_int(const int *column, int rows, scan_op op, int value, uint64_t *bitmap)
+{
+    int full = rows / 64;
+    int w = 0;
+
+#ifdef __AVX2__
+    __m256i v = _mm256_set1_epi32(value);
+    for (; w < full; w++)
+    {
+        const int *block = column + (size_t)w * 64;
+        uint64_t word = 0;
+        for (int j = 0; j < 64; j += 8)
+        {
+            __m256i x = _mm256_loadu_si256((const __m256i *)(block + j));
+            unsigned mask;
+            if (op == SCAN_EQ)
+            {
+                mask = _mm256_movemask_ps(_mm256_castsi256_ps(_mm256_cmpeq_epi32(x, v)));
+            }
+            else if (op == SCAN_GE)
+            {
+                mask = ~_mm256_movemask_ps(_mm256_castsi256_ps(_mm256_cmpgt_epi32(v, x))) & 0xff;
+            }
+            else
+            {
+                mask = ~_mm256_movemask_ps(_mm256_castsi256_ps(_mm256_cmpgt_epi32(x, v))) & 0xff;
+            }
+            word |= (uint64_t)mask << j;
+        }
+        bitmap[w] = word;
+    }
+#endif
+
+    for (; w < full; w++)
+    {
+        bitmap[w] = scan_int_scalar(column + (size_t)w * 64, 64, op, value);
+    }
+    if (rows % 64 != 0)
+    {
+        bitmap[full] = scan_int_scalar(column + (size_t)full * 64, rows % 64, op, value);
+    }
+}
+
+/**
+ * @brief Scans a long column and sets the bit of every row where `column[row] OP value` holds.
+ *
+ * Every word of the bitmap is overwritten.
+ *
+ * @param column The column to scan.
+ * @param rows The number of rows in the column.
+ * @param op The comparison to perform.
+ * @param value The value to compare against.
+ * @param bitmap The bitmap to write, BITMAP_WORDS(rows) words long.
+ */
+void scan_long(const long int *column, int rows, scan_op op, long int value, uint64_t *bitmap)
+{
+    int full = rows / 64;
+    int w = 0;
+
+#if defined(__AVX2__) && __SIZEOF_LONG__ == 8
+    __m256i v = _mm256_set1_epi64x(value);
+    for (; w < full; w++)
+    {
+        const long int *block = column + (size_t)w * 64;
+        uint64_t word = 0;
+        for (int j = 0; j < 64; j += 4)
+        {
+            __m256i x = _mm256_loadu_si256((const __m256i *)(block + j));
+            unsigned mask;
+            if (op == SCAN_EQ)
+            {
+                mask = _mm256_movemask_pd(_mm256_castsi256_pd(_mm256_cmpeq_epi64(x, v)));
+            }
+            else if (op == SCAN_GE)
+            {
+                mask = ~_mm256_movemask_pd(_mm256_castsi256_pd(_mm256_cmpgt_epi64(v, x))) & 0xf;
+            }
+            else
+            {
+                mask = ~_mm256_movemask_pd(_mm256_castsi256_pd(_mm256_cmpgt_epi64(x, v))) & 0xf;
+            }
+            word |= (uint64_t)mask << j;
+        }
+        bitmap[w] = word;
+    }
+#endif
+
+    for (; w < full; w++)
+    {
+        bitmap[w] = scan_long_scalar(column + (size_t)w * 64, 64, op, value);
+    }
+    if (rows % 64 != 0)
+    {
+        bitmap[full] = scan_long_scalar(column + (size_t)full * 64, rows % 64, op, value);
+    }
+}
+
+/**
+ * @brief Sets the bit of every row whose string contains `needle`.
+ *
+ * Every word of the bitmap is overwritten.
+ *
+ * @param column The string column to scan.
+ * @param rows The number of rows in the column.
+ * @param needle The substring to look for.
+ * @param bitmap The bitmap to write, BITMAP_WORDS(rows) words long.
+ */
+void scan_substring(char *const *column, int rows, const char *needle, uint64_t *bitmap)
+{
+    memset(bitmap, 0, BITMAP_WORDS(rows) * sizeof(uint64_t));
+    for (int i = 0; i < rows; i++)
+    {
+        if (strstr(column[i], needle) != NULL)
+        {
+            bitmap[i / 64] |= (uint64_t)1 << (i % 64);
+        }
+    }
+}
+
+/**
+ * @brief Records a match at `pos` of a packed scan: sets the bit of its row.
+ *
+ * @param column The row starts.
+ * @param rows The number of rows.
+ * @param size The size of the buffer.
+ * @param pos The position of the match from the start of row 0.
+ * @param row The row of the previous match; advanced to the row of this one.
+ * @param bitmap The bitmap to update.
+ * @return size_t The start of the next row, from which to search on.
+ */
+static size_t packed_hit(char *const *column, int rows, size_t size, size_t pos, int *row, uint64_t *bitmap)
+{
+    const char *base = column[0];
+    while (*row + 1 < rows && (size_t)(column[*row + 1] - base) <= pos)
+    {
+        (*row)++;
+    }
+    bitmap[*row / 64] |= (uint64_t)1 << (*row % 64);
+    return *row + 1 < rows ? (size_t)(column[*row + 1] - base) : size;
+}
+
+/**
+ * @brief Sets the bit of every row whose string contains `needle`, for strings stored one after another.
+ *
+ * Gives the same bitmap as scan_substring, with one pass over the strings.
+ * Every word of the bitmap is overwritten.
+ *
+ * @param column The string column to scan; the strings lie one after another from `column[0]`, each followed by
+ * its NUL.
+ * @param rows The number of rows in the column.
+ * @param size The number of bytes the strings take, NULs included.
+ * @param needle The substring to look for.
+ * @param bitmap The bitmap to write, BITMAP_WORDS(rows) words long.
+ */
+void scan_substring_packed(char *const *column, int rows, size_t size, const char *needle, uint64_t *bitmap)
+{
+    memset(bitmap, 0, BITMAP_WORDS(rows) * sizeof(uint64_t));
+    size_t n = strlen(needle);
+    if (rows == 0)
+    {
+        return;
+    }
+    if (n == 0)
+    {
+        // every string contains the empty string
+        for (int i = 0; i < rows; i++)
+        {
+            bitmap[i / 64] |= (uint64_t)1 << (i % 64);
+        }
+        return;
+    }
+
+    const char *base = column[0];
+    int row = 0;
+    size_t pos = 0;
+#ifdef __AVX2__
+    __m256i first = _mm256_set1_epi8(needle[0]);
+    __m256i last = _mm256_set1_epi8(needle[n - 1]);
+    while (pos + n - 1 + 32 <= size)
+    {
+        __m256i a = _mm256_loadu_si256((const __m256i *)(base + pos));
+        __m256i b = _mm256_loadu_si256((const __m256i *)(base + pos + n - 1));
+        uint32_t mask = (uint32_t)_mm256_movemask_epi8(_mm256_and_si256(_mm256_cmpeq_epi8(a, first),
+                                                                        _mm256_cmpeq_epi8(b, last)));
+        size_t next = pos + 32;
+        while (mask != 0)
+        {
+            size_t candidate = pos + __builtin_ctz(mask);
+            mask &= mask - 1;
+            if (memcmp(base + candidate + 1, needle + 1, n > 2 ? n - 2 : 0) == 0)
+            {
+                size_t skip = packed_hit(column, rows, size, candidate, &row, bitmap);
+                if (skip >= next)
+                {
+                    // the rest of the row needs no more searching
+                    next = skip;
+                    break;
+                }
+                mask &= ~0u << (skip - pos);
+            }
+        }
+        pos = next;
+    }
+#endif
+
+    while (pos + n <= size)
+    {
+        const char *match = (const char *)memmem(base + pos, size - pos, needle, n);
+        if (match == NULL)
+        {
+            break;
+        }
+        pos = packed_hit(column, rows, size, (size_t)(match - base), &row, bitmap);
+    }
+}
+
+/**
+ * @brief Intersects two bitmaps: dst = dst AND src.
+ *
+ * @param dst The bitmap to update.
+ * @param src The bitmap to intersect with.
+ * @param rows The number of rows both bitmaps cover.
+ */
+void bitmap_and(uint64_t *dst, const uint64_t *src, int rows)
+{
+    for (int w = 0; w < BITMAP_WORDS(rows); w++)
+    {
+        dst[w] &= src[w];
+    }
+}
+
+/**
+ * @brief Unites two bitmaps: dst = dst OR src.
+ *
+ * @param dst The bitmap to update.
+ * @param src The bitmap to unite with.
+ * @param rows The number of rows both bitmaps cover.
+ */
+void bitmap_or(uint64_t *dst, const uint64_t *src, int rows)
+{
+    for (int w = 0; w < BITMAP_WORDS(rows); w++)
+    {
+        dst[w] |= src[w];
+    }
+}
+
+/**
+ * @brief Compacts a bitmap into the ids of its set rows, in increasing order.
+ *
+ * @param bitmap The bitmap to compact.
+ * @param rows The number of rows the bitmap covers.
+ * @param row_ids The array to fill; it must have room for every set row.
+ * @return int The number of row ids written.
+ */
+int bitmap_to_rows(const uint64_t *bitmap, int rows, int *row_ids)
+{
+    int count = 0;
+    for (int w = 0; w < BITMAP_WORDS(rows); w++)
+    {
+        uint64_t word = bitmap[w];
+        while (word != 0)
+        {
+            row_ids[count++] = w * 64 + __builtin_ctzll(word);
+            word &= word - 1;
+        }
+    }
+    return count;
+}
+
+/**
+ * @brief Evaluates a single predicate (e.g. YEAR=2019) over a range of rows.
+ *
+ * @param table The table to scan.
+ * @param first The first row of the range.
+ * @param rows The number of rows in the range.
+ * @param filter The name of the filter.
+ * @param value The value of the filter.
+ * @param bitmap The bitmap to write; bit `i` is row `first + i`.
+ */
+static void scan_predicate(const song_table *table, int first, int rows, const char *filter, const char *value,
+                           uint64_t *bitmap)
+{
+    if (strcmp(filter, "ARTIST") == 0)
+    {
+        if (table->artists_buffer == NULL)
+        {
+            scan_substring(table->artists_name + first, rows, value, bitmap);
+            return;
+        }
+        double start = stats_now();
+        const char *end = first + rows < table->rows ? table->artists_name[first + rows]
+                                                     : table->artists_buffer + table->artists_buffer_size;
+        size_t size = end - table->artists_name[first];
+        scan_substring_packed(table->artists_name + first, rows, size, value, bitmap);
+        stats.artist_bytes_scanned += size;
+        stats.artist_scan_seconds += stats_now() - start;
+        return;
+    }
+
+    double start = stats_now();
+    if (strcmp(filter, "YEAR") == 0)
+    {
+        scan_int(table->released_year + first, rows, SCAN_EQ, atoi(value), bitmap);
+    }
+    else if (strcmp(filter, "MIN_YEAR") == 0)
+    {
+        scan_int(table->released_year + first, rows, SCAN_GE, atoi(value), bitmap);
+    }
+    else if (strcmp(filter, "MAX_YEAR") == 0)
+    {
+        scan_int(table->released_year + first, rows, SCAN_LE, atoi(value), bitmap);
+    }
+    else if (strcmp(filter, "MIN_STREAMS") == 0)
+    {
+        scan_long(table->streams + first, rows, SCAN_GE, atol(value), bitmap);
+    }
+    else if (strcmp(filter, "MIN_SPOTIFY_PLAYLISTS") == 0)
+    {
+        scan_int(table->in_spotify_playlists + first, rows, SCAN_GE, atoi(value), bitmap);
+    }
+    else if (strcmp(filter, "MIN_APPLE_PLAYLISTS") == 0)
+    {
+        scan_int(table->in_apple_playlists + first, rows, SCAN_GE, atoi(value), bitmap);
+    }
+    else
+    {
+        fprintf(stderr, "unknown filter: %s\n", filter);
+        exit(1);
+    }
+    stats.scan_seconds += stats_now() - start;
+    stats.values_scanned += rows;
+}
+
+/**
+ * @brief Tells whether a filter name is one scan_predicate supports.
+ */
+static int is_filter_name(const char *name)
+{
+    static const char *names[] = {"ARTIST", "YEAR", "MIN_YEAR", "MAX_YEAR", "MIN_STREAMS", "MIN_SPOTIFY_PLAYLISTS",
+                                  "MIN_APPLE_PLAYLISTS"};
+    for (size_t i = 0; i < sizeof(names) / sizeof(names[0]); i++)
+    {
+        if (strcmp(name, names[i]) == 0)
+        {
+            return 1;
+        }
+    }
+    return 0;
+}
+
+/**
+ * @brief Parses the "--filter" and "--value" arguments into a filter expression, reporting errors to the caller.
+ *
+ * `filter` and `value` are parallel lists: predicates separated by ',' must all
+ * hold, and groups separated by '|' are alternatives. For example
+ * `--filter=YEAR,ARTIST|YEAR,ARTIST --value=2021,Drake|2022,Drake` selects Drake's
+ * songs from 2021 or 2022.
+ *
+ * @param filter The filter names (see scan_predicate for the supported ones), or NULL.
+ * @param value The filter values.
+ * @param error Set to a description of the first error (an unknown filter or
+ *              a filter without a value), or to "" when there is none.
+ * @param size The size of `error`.
+ * @return filter_expr* The parsed expression, or NULL when there is no filter or an error.
+ */
+filter_expr *parse_filter_checked(const char *filter, const char *value, char *error, size_t size)
+{
+    error[0] = '\0';
+    if (filter == NULL)
+    {
+        return NULL;
+    }
+
+    size_t filter_len = strlen(filter) + 1;
+    size_t value_len = value != NULL ? strlen(value) + 1 : 1;
+    filter_expr *expr = (filter_expr *)emalloc(sizeof(filter_expr));
+    expr->text = (char *)emalloc(filter_len + value_len);
+    char *filters = expr->text;
+    char *values = expr->text + filter_len;
+    memcpy(filters, filter, filter_len);
+    memcpy(values, value != NULL ? value : "", value_len);
+
+    // every predicate is preceded by a ',' or '|', so this is an upper bound
+    int max_predicates = 1;
+    for (const char *c = filter; *c != '\0'; c++)
+    {
+        max_predicates += *c == ',' || *c == '|';
+    }
+    expr->predicates = (predicate *)emalloc(max_predicates * sizeof(predicate));
+    expr->count = 0;
+    expr->groups = 0;
+
+    char *filter_groups = NULL, *value_groups = NULL;
+    char *filter_group = strtok_r(filters, "|", &filter_groups);
+    char *value_group = strtok_r(values, "|", &value_groups);
+    while (filter_group != NULL)
+    {
+        char *filter_terms = NULL, *value_terms = NULL;
+        char *filter_term = strtok_r(filter_group, ",", &filter_terms);
+        char *value_term = value_group != NULL ? strtok_r(value_group, ",", &value_terms) : NULL;
+        while (filter_term != NULL)
+        {
+            if (!is_filter_name(filter_term))
+            {
+                snprintf(error, size, "unknown filter: %s", filter_term);
+            }
+            else if (value_term == NULL)
+            {
+                snprintf(error, size, "missing value for filter %s", filter_term);
+            }
+            if (error[0] != '\0')
+            {
+                free_filter(expr);
+                return NULL;
+            }
+            predicate *p = &expr->predicates[expr->count++];
+            p->name = filter_term;
+            p->value = value_term;
+            p->group = expr->groups;
+
+            filter_term = strtok_r(NULL, ",", &filter_terms);
+            value_term = value_terms != NULL ? strtok_r(NULL, ",", &value_terms) : NULL;
+        }
+        expr->groups++;
+
+        filter_group = strtok_r(NULL, "|", &filter_groups);
+        value_group = value_groups != NULL ? strtok_r(NULL, "|", &value_groups) : NULL;
+    }
+
+    return expr;
+}
+
+/**
+ * @brief Parses the "--filter" and "--value" arguments into a filter expression.
+ *
+ * See parse_filter_checked; an unknown filter or a filter without a value
+ * ends the program.
+ *
+ * @param filter The filter names, or NULL.
+ * @param value The filter values.
+ * @return filter_expr* The parsed expression, or NULL when there is no filter.
+ */
+filter_expr *parse_filter(const char *filter, const char *value)
+{
+    char error[256];
+    filter_expr *expr = parse_filter_checked(filter, value, error, sizeof(error));
+    if (error[0] != '\0')
+    {
+        fprintf(stderr, "%s\n", error);
+        exit(1);
+    }
+    return expr;
+}
+
+/**
+ * @brief Frees a filter expression.
+ *
+ * @param expr The expression to free; may be NULL.
+ */
+void free_filter(filter_expr *expr)
+{
+    if (expr != NULL)
+    {
+        free(expr->text);
+        free(expr->predicates);
+        free(expr);
+    }
+}
+
+/**
+ * @brief Tells whether a song released in `year` could satisfy the filter,
+ * judging by its YEAR, MIN_YEAR and MAX_YEAR predicates alone.
+ *
+ * Used to skip data that is known to hold a single year (e.g. a partition).
+ *
+ * @param expr The filter, or NULL for no filter.
+ * @param year The release year.
+ * @return int 1 if a song from that year may be selected, 0 if none can be.
+ */
+int filter_may_select_year(const filter_expr *expr, int year)
+{
+    if (expr == NULL)
+    {
+        return 1;
+    }
+
+    int i = 0;
+    while (i < expr->count)
+    {
+        int group = expr->predicates[i].group;
+        int possible = 1;
+        for (; i < expr->count && expr->predicates[i].group == group; i++)
+        {
+            const predicate *p = &expr->predicates[i];
+            int v = atoi(p->value);
+            if ((strcmp(p->name, "YEAR") == 0 && year != v) || (strcmp(p->name, "MIN_YEAR") == 0 && year < v) ||
+                (strcmp(p->name, "MAX_YEAR") == 0 && year > v))
+            {
+                possible = 0;
+            }
+        }
+        if (possible)
+        {
+            return 1;
+        }
+    }
+    return 0;
+}
+
+/**
+ * @brief Returns the columns a filter reads.
+ *
+ * @param expr The filter, or NULL for no filter.
+ * @return unsigned int The COL_* flags of the columns the predicates scan.
+ */
+unsigned int filter_columns(const filter_expr *expr)
+{
+    unsigned int columns = 0;
+    for (int i = 0; expr != NULL && i < expr->count; i++)
+    {
+        const char *name = expr->predicates[i].name;
+        if (strcmp(name, "ARTIST") == 0)
+        {
+            columns |= COL_ARTISTS_NAME;
+        }
+        else if (strcmp(name, "YEAR") == 0 || strcmp(name, "MIN_YEAR") == 0 || strcmp(name, "MAX_YEAR") == 0)
+        {
+            columns |= COL_RELEASED_YEAR;
+        }
+        else if (strcmp(name, "MIN_STREAMS") == 0)
+        {
+            columns |= COL_STREAMS;
+        }
+        else if (strcmp(name, "MIN_SPOTIFY_PLAYLISTS") == 0)
+        {
+            columns |= COL_SPOTIFY_PLAYLISTS;
+        }
+        else if (strcmp(name, "MIN_APPLE_PLAYLISTS") == 0)
+        {
+            columns |= COL_APPLE_PLAYLISTS;
+        }
+    }
+    return columns;
+}
+
+/**
+ * @brief Selects the rows of a range that satisfy the filter.
+ *
+ * @param table The table to filter.
+ * @param first The first row of the range.
+ * @param rows The number of rows in the range.
+ * @param expr The filter.
+ * @param bitmaps Three bitmaps of at least `rows` bits to work in.
+ * @param row_ids Where to store the selected row ids.
+ * @return int The number of selected rows.
+ */
+static int filter_range(const song_table *table, int first, int rows, const filter_expr *expr,
+                        uint64_t **bitmaps, int *row_ids)
+{
+    uint64_t *result = bitmaps[0];
+    uint64_t *group = bitmaps[1];
+    uint64_t *term = bitmaps[2];
+    memset(result, 0, BITMAP_WORDS(rows) * sizeof(uint64_t));
+
+    for (int i = 0; i < expr->count; i++)
+    {
+        const predicate *p = &expr->predicates[i];
+        int first_term = i == 0 || expr->predicates[i - 1].group != p->group;
+        int last_term = i == expr->count - 1 || expr->predicates[i + 1].group != p->group;
+
+        scan_predicate(table, first, rows, p->name, p->value, first_term ? group : term);
+        if (!first_term)
+        {
+            bitmap_and(group, term, rows);
+        }
+        if (last_term)
+        {
+            bitmap_or(result, group, rows);
+        }
+    }
+
+    int count = bitmap_to_rows(result, rows, row_ids);
+    for (int i = 0; i < count; i++)
+    {
+        row_ids[i] += first;
+    }
+    return count;
+}
+
+/**
+ * @brief An struct that holds the input and output of one filter task: a block of rows.
+ *
+ * `zone` is the zone map of the block, or NULL when the table has none.
+ */
+typedef struct
+{
+    const song_table *table;
+    const filter_expr *expr;
+    const zone_map *zone;
+    int first;
+    int rows;
+    int *row_ids;
+    int count;
+} filter_task;
+
+/**
+ * @brief Filters the block of one task, writing its selected row ids at the start of `row_ids`.
+ */
+static void filter_block(void *arg)
+{
+    filter_task *task = (filter_task *)arg;
+    task->count = 0;
+    if (task->zone != NULL && !zone_may_match(task->zone, task->expr))
+    {
+        stats.blocks_skipped++;
+        return;
+    }
+    if (task->zone != NULL)
+    {
+        stats.blocks_scanned++;
+    }
+    uint64_t *bitmaps[] = {new_bitmap(task->rows), new_bitmap(task->rows), new_bitmap(task->rows)};
+    task->count = filter_range(task->table, task->first, task->rows, task->expr, bitmaps, task->row_ids);
+    for (int b = 0; b < 3; b++)
+    {
+        free(bitmaps[b]);
+    }
+}
+
+/**
+ * @brief Filters the blocks of a table as tasks of the task pool.
+ *
+ * Each block writes its row ids where its rows start in `row_ids`; they are
+ * then moved down after those of the blocks before it.
+ *
+ * @return int The number of selected rows.
+ */
+static int filter_blocks(const song_table *table, const filter_expr *expr, int blocks, int *row_ids)
+{
+    filter_task *tasks = (filter_task *)emalloc(blocks * sizeof(filter_task));
+    task_group group = TASK_GROUP_INIT;
+    for (int i = 0; i < blocks; i++)
+    {
+        filter_task *task = &tasks[i];
+        task->table = table;
+        task->expr = expr;
+        task->zone = table->zones != NULL ? &table->zones[i] : NULL;
+        task->first = task->zone != NULL ? task->zone->first_row : i * FILTER_BLOCK_ROWS;
+        task->rows = task->zone != NULL                               ? task->zone->rows
+                     : table->rows - task->first < FILTER_BLOCK_ROWS ? table->rows - task->first
+                                                                     : FILTER_BLOCK_ROWS;
+        task->row_ids = row_ids + task->first;
+        pool_submit(&group, filter_block, task);
+    }
+    pool_wait(&group);
+
+    int count = 0;
+    for (int i = 0; i < blocks; i++)
+    {
+        memmove(row_ids + count, tasks[i].row_ids, tasks[i].count * sizeof(int));
+        count += tasks[i].count;
+    }
+    free(tasks);
+    return count;
+}
+
+/**
+ * @brief Selects the rows of a table that satisfy the filter.
+ *
+ * Each predicate is scanned into a bitmap; the bitmaps of a group are
+ * intersected and the groups are united. When the table has zone maps, each
+ * block is filtered on its own and the blocks whose zone map rules the
+ * filter out are skipped without being scanned. With more than one thread
+ * in the task pool, the blocks (zones, or FILTER_BLOCK_ROWS rows without
+ * zone maps) are filtered concurrently.
+ *
+ * @param table The table to filter.
+ * @param expr The filter (see parse_filter); NULL selects every row.
+ * @param count Set to the number of selected rows.
+ * @return int* The selected row ids in increasing order.
+ */
+int *filter_table(const song_table *table, const filter_expr *expr, int *count)
+{
+    int rows = table->rows;
+    int *row_ids = (int *)emalloc((rows > 0 ? rows : 1) * sizeof(int));
+
+    if (expr == NULL)
+    {
+        for (int i = 0; i < rows; i++)
+        {
+            row_ids[i] = i;
+        }
+        *count = rows;
+        return row_ids;
+    }
+
+    int blocks = table->zones != NULL ? table->zone_count : (rows + FILTER_BLOCK_ROWS - 1) / FILTER_BLOCK_ROWS;
+    if (pool_threads() > 1 && blocks > 1)
+    {
+        *count = filter_blocks(table, expr, blocks, row_ids);
+        return row_ids;
+    }
+
+    if (table->zones == NULL)
+    {
+        uint64_t *bitmaps[] = {new_bitmap(rows), new_bitmap(rows), new_bitmap(rows)};
+        *count = filter_range(table, 0, rows, expr, bitmaps, row_ids);
+        for (int b = 0; b < 3; b++)
+        {
+            free(bitmaps[b]);
+        }
+        return row_ids;
+    }
+
+    int largest = 0;
+    for (int z = 0; z < table->zone_count; z++)
+    {
+        largest = table->zones[z].rows > largest ? table->zones[z].rows : largest;
+    }
+    uint64_t *bitmaps[] = {new_bitmap(largest), new_bitmap(largest), new_bitmap(largest)};
+    *count = 0;
+    for (int z = 0; z < table->zone_count; z++)
+    {
+        const zone_map *zone = &table->zones[z];
+        if (!zone_may_match(zone, expr))
+        {
+            stats.blocks_skipped++;
+            continue;
+        }
+        stats.blocks_scanned++;
+        *count += filter_range(table, zone->first_row, zone->rows, expr, bitmaps, row_ids + *count);
+    }
+    for (int b = 0; b < 3; b++)
+    {
+        free(bitmaps[b]);
+    }
+    return row_ids;
+}
@@ -0,0 +1,79 @@
+/** @file scan.h
+ *  @brief Function prototypes for the column scans used by the filters.
+ *
+ * A scan compares a whole column against a value and produces a selection
+ * bitmap with one bit per row (bit `i % 64` of word `i / 64` is row `i`).
+ * Bitmaps of several predicates are combined with bitmap_and/bitmap_or and
+ * the final bitmap is compacted into row ids.
+ */
+#ifndef _SCAN_H_
+#define _SCAN_H_
+
+#include <stddef.h>
+#include <stdint.h>
+#include "table.h"
+
+#define BITMAP_WORDS(rows) (((rows) + 63) / 64)
+
+/**
+ * @brief The rows of a block a filter task scans, in tables without zone maps.
+ */
+#define FILTER_BLOCK_ROWS 65536
+
+/**
+ * @brief The comparisons a numeric scan can perform (column OP value).
+ */
+typedef enum
+{
+    SCAN_EQ,
+    SCAN_GE,
+    SCAN_LE
+} scan_op;
+
+/**
+ * @brief An struct that represents one predicate of a filter, e.g. YEAR=2019.
+ *
+ * Predicates with the same `group` must all hold; a row is selected when
+ * every predicate of at least one group holds.
+ */
+typedef struct
+{
+    char *name;
+    char *value;
+    int group;
+} predicate;
+
+/**
+ * @brief An struct that represents a parsed "--filter"/"--value" pair.
+ *
+ * The predicates are stored group by group. `text` owns the strings the
+ * predicates point into.
+ */
+typedef struct
+{
+    int count;
+    int groups;
+    predicate *predicates;
+    char *text;
+} filter_expr;
+
+/**
+ * Function protypes associated with the column scans.
+ *
+ */
+uint64_t *new_bitmap(int rows);
+void scan_int(const int *column, int rows, scan_op op, int value, uint64_t *bitmap);
+void scan_long(const long int *column, int rows, scan_op op, long int value, uint64_t *bitmap);
+void scan_substring(char *const *column, int rows, const char *needle, uint64_t *bitmap);
+void scan_substring_packed(char *const *column, int rows, size_t size, const char *needle, uint64_t *bitmap);
+void bitmap_and(uint64_t *dst, const uint64_t *src, int rows);
+void bitmap_or(uint64_t *dst, const uint64_t *src, int rows);
+int bitmap_to_rows(const uint64_t *bitmap, int rows, int *row_ids);
+filter_expr *parse_filter_checked(const char *filter, const char *value, char *error, size_t size);
+filter_expr *parse_filter(const char *filter, const char *value);
+void free_filter(filter_expr *expr);
+int filter_may_select_year(const filter_expr *expr, int year);
+unsigned int filter_columns(const filter_expr *expr);
+int *filter_table(const song_table *table, const filter_expr *expr, int *count);
+
+#endif
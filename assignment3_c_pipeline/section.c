@@ -0,0 +1,39 @@
+/** @file section.c
+ *  @brief Implementation of section.h
+ *
+ */
+#include <stddef.h>
+#include <stdio.h>
+#include "section.h"
+
+/**
+ * @brief Returns the size of a section once padded to a multiple of 8 bytes.
+ */
+size_t padded(size_t size)
+{
+    return (size + 7) & ~(size_t)7;
+}
+
+/**
+ * @brief Writes a section followed by the zero padding that aligns the next one.
+ */
+void write_section(FILE *file, const void *data, size_t size)
+{
+    static const char zeros[8];
+    fwrite(data, 1, size, file);
+    fwrite(zeros, 1, padded(size) - size, file);
+}
+
+/**
+ * @brief Reads a section written by write_section into `data` and skips its padding.
+ *
+ * @return int 0 on success, -1 if the file is too short.
+ */
+int read_section(FILE *file, void *data, size_t size)
+{
+    if (fread(data, 1, size, file) != size)
+    {
+        return -1;
+    }
+    return fseek(file, padded(size) - size, SEEK_CUR);
+}
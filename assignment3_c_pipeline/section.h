@@ -0,0 +1,21 @@
+/** @file section.h
+ *  @brief Function prototypes for the 8-byte aligned sections of the binary file formats.
+ *
+ * Column files and the columnar output format store each array as a section
+ * followed by zero padding, so every section starts at a multiple of 8 bytes.
+ */
+#ifndef _SECTION_H_
+#define _SECTION_H_
+
+#include <stddef.h>
+#include <stdio.h>
+
+/**
+ * Function protypes associated with aligned sections.
+ *
+ */
+size_t padded(size_t size);
+void write_section(FILE *file, const void *data, size_t size);
+int read_section(FILE *file, void *data, size_t size);
+
+#endif
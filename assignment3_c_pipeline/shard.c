@@ -0,0 +1,186 @@
+/** @file shard.c
+ *  @brief Implementation of shard.h
+ *
+ * Each shard is loaded, filtered, sorted and cut to `--limit` rows on its
+ * own, by one task of the task pool per shard. The sorted rows
+ * of the shards are then merged with a loser tree into one global order.
+ *
+ * The result is the same as querying the concatenation of the shards:
+ * ordering ties by shard (earlier shards first for ASC, later shards first
+ * for DES, which reverses the ascending order) keeps the sort stable, and
+ * without "--order_by" every key is equal, so the shards are simply
+ * concatenated (or, for DES, concatenated in reverse).
+ */
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "dataset.h"
+#include "emalloc.h"
+#include "functions.h"
+#include "losertree.h"
+#include "output.h"
+#include "pool.h"
+#include "rowfile.h"
+#include "scan.h"
+#include "shard.h"
+#include "sort.h"
+#include "stats.h"
+#include "table.h"
+
+/**
+ * @brief An struct that holds the query the shards run.
+ */
+typedef struct
+{
+    const filter_expr *filter;
+    unsigned int columns;
+    const char *order_by;
+    const char *order;
+    const char *limit;
+    sort_algorithm algorithm;
+} shard_work;
+
+/**
+ * @brief An struct that holds one shard and its selected rows, in output order.
+ */
+typedef struct
+{
+    const char *path;
+    const shard_work *work;
+    song_table *table;
+    int *rows;
+    int count;
+    int position;
+} shard;
+
+/**
+ * @brief A scan task: queries one shard.
+ */
+static void scan_shard(void *arg)
+{
+    shard *s = (shard *)arg;
+    const shard_work *work = s->work;
+    order_spec spec;
+    parse_order_spec(work->order_by, &spec);
+
+    double start = stats_now();
+    s->table = load_dataset(s->path, work->filter, work->columns);
+    stats.rows_loaded += s->table->rows;
+    stats.load_seconds += stats_now() - start;
+
+    start = stats_now();
+    s->rows = filter_table(s->table, work->filter, &s->count);
+    stats.rows_selected += s->count;
+    stats.filter_seconds += stats_now() - start;
+
+    start = stats_now();
+    sort_rows(s->table, s->rows, s->count, work->order_by, work->algorithm);
+    s->count = limit_rows(s->rows, s->count, work->order, work->limit);
+    stats.sort_seconds += stats_now() - start;
+
+    table_materialize(s->table, COL_OUTPUT | order_spec_columns(&spec), s->rows, s->count);
+    s->position = 0;
+}
+
+/**
+ * @brief An struct that holds what the merge compares.
+ */
+typedef struct
+{
+    shard *shards;
+    order_spec spec;
+    int descending;
+} shard_merge;
+
+/**
+ * @brief loser_less for shards: by key, then by shard so that the merge is stable.
+ */
+static int shard_less(int a, int b, void *context)
+{
+    shard_merge *merge = (shard_merge *)context;
+    const shard *x = &merge->shards[a];
+    const shard *y = &merge->shards[b];
+    int x_done = x->position == x->count;
+    int y_done = y->position == y->count;
+    if (x_done || y_done)
+    {
+        return x_done == y_done ? a < b : y_done;
+    }
+    int c = compare_rows(&merge->spec, x->table, x->rows[x->position], y->table, y->rows[y->position]);
+    if (c != 0)
+    {
+        return merge->descending ? c > 0 : c < 0;
+    }
+    return merge->descending ? a > b : a < b;
+}
+
+/**
+ * @brief Runs a row query over several datasets, scanning them in parallel, and writes the output.
+ *
+ * Produces the same output as the in-memory path of main on the
+ * concatenation of the datasets.
+ *
+ * @param paths The datasets, each a csv file, a column file or a partitioned directory.
+ * @param count The number of datasets.
+ * @param filter The filter, or NULL.
+ * @param columns The COL_* flags of the columns the query filters or sorts on.
+ * @param order_by The "--order_by" list, or NULL to keep the input order.
+ * @param order "ASC", "DES" or NULL.
+ * @param limit The most rows to write, or NULL.
+ * @param algorithm The algorithm used to sort each shard.
+ * @param format The format of the output.
+ */
+void shard_query(char *const *paths, int count, const filter_expr *filter, unsigned int columns,
+                 const char *order_by, const char *order, const char *limit, sort_algorithm algorithm,
+                 output_format format)
+{
+    shard_work work = {filter, columns, order_by, order, limit, algorithm};
+    shard *shards = (shard *)emalloc(count * sizeof(shard));
+    task_group group = TASK_GROUP_INIT;
+    for (int i = 0; i < count; i++)
+    {
+        shards[i].path = paths[i];
+        shards[i].work = &work;
+        pool_submit(&group, scan_shard, &shards[i]);
+    }
+    pool_wait(&group);
+
+    double start = stats_now();
+    shard_merge merge;
+    merge.shards = shards;
+    parse_order_spec(order_by, &merge.spec);
+    merge.descending = order != NULL && strcmp(order, "DES") == 0;
+    const char *value_by = order_value_name(order_by);
+    order_field field = parse_order_by(value_by);
+    long remaining = limit != NULL ? atol(limit) : -1;
+    if (limit != NULL && remaining < 0)
+    {
+        remaining = 0;
+    }
+
+    output_writer *output = open_output(format, value_by);
+    loser_tree *tree = new_loser_tree(count, shard_less, &merge);
+    for (; remaining != 0; remaining--)
+    {
+        shard *s = &shards[loser_tree_winner(tree)];
+        if (s->position == s->count)
+        {
+            break;
+        }
+        song_row row;
+        table_row(s->table, s->rows[s->position], field, &row);
+        output_row(output, &row);
+        s->position++;
+        loser_tree_replay(tree);
+    }
+    free_loser_tree(tree);
+    close_output(output);
+    stats.output_seconds = stats_now() - start;
+
+    for (int i = 0; i < count; i++)
+    {
+        free(shards[i].rows);
+        free_table(shards[i].table);
+    }
+    free(shards);
+}
@@ -0,0 +1,20 @@
+/** @file shard.h
+ *  @brief Function prototypes for querying several datasets (shards) in parallel.
+ *
+ */
+#ifndef _SHARD_H_
+#define _SHARD_H_
+
+#include "output.h"
+#include "scan.h"
+#include "sort.h"
+
+/**
+ * Function protypes associated with sharded queries.
+ *
+ */
+void shard_query(char *const *paths, int count, const filter_expr *filter, unsigned int columns,
+                 const char *order_by, const char *order, const char *limit, sort_algorithm algorithm,
+                 output_format format);
+
+#endif
@@ -0,0 +1,392 @@
+/** @file sketch.c
+ *  @brief Implementation of sketch.h
+ *
+ */
+#include <math.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+#include "emalloc.h"
+#include "rowfile.h"
+#include "sketch.h"
+
+/**
+ * @brief Hashes a string to 64 bits: FNV-1a followed by the MurmurHash3 finalizer.
+ *
+ * The finalizer spreads the bits, as the sketches use both ends of the hash.
+ */
+uint64_t sketch_hash(const char *s)
+{
+    uint64_t h = 14695981039346656037ull;
+    for (; *s != '\0'; s++)
+    {
+        h = (h ^ (unsigned char)*s) * 1099511628211ull;
+    }
+    h ^= h >> 33;
+    h *= 0xff51afd7ed558ccdull;
+    h ^= h >> 33;
+    h *= 0xc4ceb9fe1a85ec53ull;
+    h ^= h >> 33;
+    return h;
+}
+
+/**
+ * @brief Adds a hashed string to a HyperLogLog sketch.
+ *
+ * The top HLL_PRECISION bits pick a register, which keeps the longest run of
+ * leading zeros (plus one) seen in the remaining bits.
+ *
+ * @param hll The sketch.
+ * @param hash The hash of the string (see sketch_hash).
+ */
+void hll_add(hyperloglog *hll, uint64_t hash)
+{
+    int index = (int)(hash >> (64 - HLL_PRECISION));
+    uint64_t rest = (hash << HLL_PRECISION) | (1ull << (HLL_PRECISION - 1));
+    uint8_t rank = (uint8_t)(__builtin_clzll(rest) + 1);
+    if (rank > hll->registers[index])
+    {
+        hll->registers[index] = rank;
+    }
+}
+
+/**
+ * @brief Estimates the number of distinct strings added to a HyperLogLog sketch.
+ *
+ * Small counts, where many registers are still zero, are estimated by
+ * linear counting instead.
+ *
+ * @param hll The sketch.
+ * @return double The estimate.
+ */
+double hll_estimate(const hyperloglog *hll)
+{
+    double m = HLL_REGISTERS;
+    double sum = 0;
+    int zeros = 0;
+    for (int i = 0; i < HLL_REGISTERS; i++)
+    {
+        sum += 1.0 / (double)(1ull << hll->registers[i]);
+        zeros += hll->registers[i] == 0;
+    }
+    double estimate = 0.7213 / (1 + 1.079 / m) * m * m / sum;
+    if (estimate <= 2.5 * m && zeros > 0)
+    {
+        estimate = m * log(m / zeros);
+    }
+    return estimate;
+}
+
+/**
+ * @brief Returns the column of a row of a Count-Min sketch for a hash.
+ *
+ * The rows use the hashes h1 + i * h2 built from the two halves of the
+ * 64-bit hash.
+ */
+static int cm_column(uint64_t hash, int row)
+{
+    uint32_t h1 = (uint32_t)hash;
+    uint32_t h2 = (uint32_t)(hash >> 32) | 1;
+    return (int)((h1 + (uint32_t)row * h2) & (CM_WIDTH - 1));
+}
+
+/**
+ * @brief Adds a weight to the total of a hashed string in a Count-Min sketch.
+ *
+ * @param cm The sketch.
+ * @param hash The hash of the string (see sketch_hash).
+ * @param weight The weight to add; must not be negative.
+ */
+void cm_add(count_min *cm, uint64_t hash, int64_t weight)
+{
+    for (int i = 0; i < CM_DEPTH; i++)
+    {
+        cm->counts[i][cm_column(hash, i)] += weight;
+    }
+}
+
+/**
+ * @brief Estimates the total weight of a hashed string in a Count-Min sketch.
+ *
+ * @param cm The sketch.
+ * @param hash The hash of the string (see sketch_hash).
+ * @return int64_t The smallest of its counters, which is at least its total.
+ */
+int64_t cm_estimate(const count_min *cm, uint64_t hash)
+{
+    int64_t estimate = cm->counts[0][cm_column(hash, 0)];
+    for (int i = 1; i < CM_DEPTH; i++)
+    {
+        int64_t count = cm->counts[i][cm_column(hash, i)];
+        if (count < estimate)
+        {
+            estimate = count;
+        }
+    }
+    return estimate;
+}
+
+/**
+ * @brief Creates an empty Space-Saving summary.
+ *
+ * @param capacity The number of counters.
+ * @return space_saving* The summary, to be freed with free_space_saving.
+ */
+space_saving *new_space_saving(int capacity)
+{
+    space_saving *ss = (space_saving *)emalloc(sizeof(space_saving));
+    int slots = 2;
+    while (slots < 2 * capacity)
+    {
+        slots *= 2;
+    }
+    ss->heap = (ss_counter *)emalloc(capacity * sizeof(ss_counter));
+    ss->size = 0;
+    ss->capacity = capacity;
+    ss->slots = (int *)emalloc(slots * sizeof(int));
+    ss->slot_mask = slots - 1;
+    for (int i = 0; i < slots; i++)
+    {
+        ss->slots[i] = -1;
+    }
+    return ss;
+}
+
+/**
+ * @brief Returns the slot of a key in the hash table, or the empty slot where it belongs.
+ */
+static int ss_find(const space_saving *ss, const char *key, uint64_t hash)
+{
+    int i = (int)(hash & ss->slot_mask);
+    while (ss->slots[i] != -1)
+    {
+        const ss_counter *c = &ss->heap[ss->slots[i]];
+        if (c->hash == hash && strcmp(c->key, key) == 0)
+        {
+            break;
+        }
+        i = (i + 1) & ss->slot_mask;
+    }
+    return i;
+}
+
+/**
+ * @brief Empties a slot of the hash table, shifting back the entries that probed past it.
+ */
+static void ss_remove_slot(space_saving *ss, int slot)
+{
+    int i = slot;
+    ss->slots[i] = -1;
+    for (int j = (i + 1) & ss->slot_mask; ss->slots[j] != -1; j = (j + 1) & ss->slot_mask)
+    {
+        int home = (int)(ss->heap[ss->slots[j]].hash & ss->slot_mask);
+        // the entry at j may move to i unless its home lies cyclically in (i, j]
+        int stays = i <= j ? (home > i && home <= j) : (home > i || home <= j);
+        if (!stays)
+        {
+            ss->slots[i] = ss->slots[j];
+            ss->heap[ss->slots[i]].slot = i;
+            ss->slots[j] = -1;
+            i = j;
+        }
+    }
+}
+
+/**
+ * @brief Swaps two counters of the heap and updates the hash table.
+ */
+static void ss_swap(space_saving *ss, int a, int b)
+{
+    ss_counter tmp = ss->heap[a];
+    ss->heap[a] = ss->heap[b];
+    ss->heap[b] = tmp;
+    ss->slots[ss->heap[a].slot] = a;
+    ss->slots[ss->heap[b].slot] = b;
+}
+
+/**
+ * @brief Moves a counter whose count grew down the heap.
+ */
+static void ss_sift_down(space_saving *ss, int i)
+{
+    while (1)
+    {
+        int smallest = i;
+        int left = 2 * i + 1, right = 2 * i + 2;
+        if (left < ss->size && ss->heap[left].count < ss->heap[smallest].count)
+        {
+            smallest = left;
+        }
+        if (right < ss->size && ss->heap[right].count < ss->heap[smallest].count)
+        {
+            smallest = right;
+        }
+        if (smallest == i)
+        {
+            return;
+        }
+        ss_swap(ss, i, smallest);
+        i = smallest;
+    }
+}
+
+/**
+ * @brief Moves a new counter up the heap.
+ */
+static void ss_sift_up(space_saving *ss, int i)
+{
+    while (i > 0 && ss->heap[(i - 1) / 2].count > ss->heap[i].count)
+    {
+        ss_swap(ss, i, (i - 1) / 2);
+        i = (i - 1) / 2;
+    }
+}
+
+/**
+ * @brief Adds a weight to the total of a string in a Space-Saving summary.
+ *
+ * A string without a counter takes a free one or, when all are used, the
+ * one with the smallest count, inheriting that count as its error.
+ *
+ * @param ss The summary.
+ * @param key The string; it is copied.
+ * @param hash The hash of the string (see sketch_hash).
+ * @param weight The weight to add; must not be negative.
+ */
+void ss_add(space_saving *ss, const char *key, uint64_t hash, int64_t weight)
+{
+    int slot = ss_find(ss, key, hash);
+    if (ss->slots[slot] != -1)
+    {
+        int i = ss->slots[slot];
+        ss->heap[i].count += weight;
+        ss_sift_down(ss, i);
+        return;
+    }
+
+    if (ss->size < ss->capacity)
+    {
+        int i = ss->size++;
+        ss_counter c = {strdup(key), hash, weight, 0, slot};
+        ss->heap[i] = c;
+        ss->slots[slot] = i;
+        ss_sift_up(ss, i);
+        return;
+    }
+
+    // replace the string with the smallest count
+    ss_counter *min = &ss->heap[0];
+    int64_t inherited = min->count;
+    ss_remove_slot(ss, min->slot);
+    free(min->key);
+    slot = ss_find(ss, key, hash);
+    ss_counter c = {strdup(key), hash, inherited + weight, inherited, slot};
+    ss->heap[0] = c;
+    ss->slots[slot] = 0;
+    ss_sift_down(ss, 0);
+}
+
+/**
+ * @brief Frees a Space-Saving summary and its strings.
+ *
+ * @param ss The summary.
+ */
+void free_space_saving(space_saving *ss)
+{
+    for (int i = 0; i < ss->size; i++)
+    {
+        free(ss->heap[i].key);
+    }
+    free(ss->heap);
+    free(ss->slots);
+    free(ss);
+}
+
+/**
+ * @brief Creates an empty reservoir.
+ *
+ * @param capacity The number of rows to sample.
+ * @param seed The seed of the random numbers; the same seed gives the same sample.
+ * @return reservoir* The reservoir, to be freed with free_reservoir.
+ */
+reservoir *new_reservoir(int capacity, uint64_t seed)
+{
+    reservoir *sample = (reservoir *)emalloc(sizeof(reservoir));
+    sample->rows = (song_row *)emalloc((capacity > 0 ? capacity : 1) * sizeof(song_row));
+    sample->positions = (long *)emalloc((capacity > 0 ? capacity : 1) * sizeof(long));
+    sample->size = 0;
+    sample->capacity = capacity;
+    sample->seen = 0;
+    sample->random = seed != 0 ? seed : 1;
+    return sample;
+}
+
+/**
+ * @brief Returns the next random number of a reservoir (xorshift64*).
+ */
+static uint64_t next_random(reservoir *sample)
+{
+    sample->random ^= sample->random >> 12;
+    sample->random ^= sample->random << 25;
+    sample->random ^= sample->random >> 27;
+    return sample->random * 0x2545f4914f6cdd1dull;
+}
+
+/**
+ * @brief Offers the next row of the stream to a reservoir (Algorithm R).
+ *
+ * Every row of the stream ends up in the sample with the same probability.
+ * When a slot is returned, the caller stores the row with reservoir_store;
+ * rows that are not taken never need to be decoded.
+ *
+ * @param sample The reservoir.
+ * @return int The slot the row goes to, or -1 if it is not sampled.
+ */
+int reservoir_offer(reservoir *sample)
+{
+    sample->seen++;
+    if (sample->size < sample->capacity)
+    {
+        return sample->size++;
+    }
+    uint64_t j = next_random(sample) % (uint64_t)sample->seen;
+    return j < (uint64_t)sample->capacity ? (int)j : -1;
+}
+
+/**
+ * @brief Stores a copy of the row just offered in the slot reservoir_offer returned.
+ *
+ * @param sample The reservoir.
+ * @param slot The slot.
+ * @param row The row; its names are copied.
+ */
+void reservoir_store(reservoir *sample, int slot, const song_row *row)
+{
+    if (sample->seen > sample->capacity)
+    {
+        // the reservoir is full, so the slot holds an earlier row
+        free((char *)sample->rows[slot].track_name);
+        free((char *)sample->rows[slot].artists_name);
+    }
+    sample->rows[slot] = *row;
+    sample->rows[slot].track_name = strdup(row->track_name);
+    sample->rows[slot].artists_name = strdup(row->artists_name);
+    sample->positions[slot] = sample->seen - 1;
+}
+
+/**
+ * @brief Frees a reservoir and its rows.
+ *
+ * @param sample The reservoir.
+ */
+void free_reservoir(reservoir *sample)
+{
+    for (int i = 0; i < sample->size; i++)
+    {
+        free((char *)sample->rows[i].track_name);
+        free((char *)sample->rows[i].artists_name);
+    }
+    free(sample->rows);
+    free(sample->positions);
+    free(sample);
+}
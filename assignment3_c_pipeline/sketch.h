@@ -0,0 +1,106 @@
+/** @file sketch.h
+ *  @brief Function prototypes for the fixed-size summaries used by the approximate queries.
+ *
+ * hyperloglog  estimates the number of distinct strings, with a standard
+ *              error of 1.04 / sqrt(HLL_REGISTERS) (0.81%).
+ * count_min    estimates the total weight of a string; the estimate is never
+ *              below the true total and exceeds it by at most
+ *              e / CM_WIDTH of the weight of the stream with probability
+ *              1 - e^-CM_DEPTH.
+ * space_saving keeps the strings with the largest total weight; every total
+ *              it reports lies between count - error and count.
+ * reservoir    keeps a uniform random sample of a fixed number of rows.
+ *
+ * Each uses the same memory however long the stream is.
+ */
+#ifndef _SKETCH_H_
+#define _SKETCH_H_
+
+#include <stdint.h>
+#include "rowfile.h"
+
+#define HLL_PRECISION 14
+#define HLL_REGISTERS (1 << HLL_PRECISION)
+#define CM_DEPTH 4
+#define CM_WIDTH 8192
+
+/**
+ * @brief An struct that represents a HyperLogLog sketch.
+ */
+typedef struct
+{
+    uint8_t registers[HLL_REGISTERS];
+} hyperloglog;
+
+/**
+ * @brief An struct that represents a Count-Min sketch of 64-bit weights.
+ */
+typedef struct
+{
+    int64_t counts[CM_DEPTH][CM_WIDTH];
+} count_min;
+
+/**
+ * @brief An struct that represents one counter of a Space-Saving summary.
+ *
+ * `error` is the count the string may have inherited from the string it
+ * replaced; `slot` is where the counter is in the hash table.
+ */
+typedef struct
+{
+    char *key;
+    uint64_t hash;
+    int64_t count;
+    int64_t error;
+    int slot;
+} ss_counter;
+
+/**
+ * @brief An struct that represents a Space-Saving summary with a fixed number of counters.
+ *
+ * The counters form a min-heap by count; `slots` is an open-addressing hash
+ * table from the keys to their position in the heap (-1 when empty).
+ */
+typedef struct
+{
+    ss_counter *heap;
+    int size;
+    int capacity;
+    int *slots;
+    int slot_mask;
+} space_saving;
+
+/**
+ * @brief An struct that represents a reservoir sample of rows.
+ *
+ * `rows` holds copies of the sampled rows (their names included) and
+ * `positions` the position of each in the stream.
+ */
+typedef struct
+{
+    song_row *rows;
+    long *positions;
+    int size;
+    int capacity;
+    long seen;
+    uint64_t random;
+} reservoir;
+
+/**
+ * Function protypes associated with the sketches.
+ *
+ */
+uint64_t sketch_hash(const char *s);
+void hll_add(hyperloglog *hll, uint64_t hash);
+double hll_estimate(const hyperloglog *hll);
+void cm_add(count_min *cm, uint64_t hash, int64_t weight);
+int64_t cm_estimate(const count_min *cm, uint64_t hash);
+space_saving *new_space_saving(int capacity);
+void ss_add(space_saving *ss, const char *key, uint64_t hash, int64_t weight);
+void free_space_saving(space_saving *ss);
+reservoir *new_reservoir(int capacity, uint64_t seed);
+int reservoir_offer(reservoir *sample);
+void reservoir_store(reservoir *sample, int slot, const song_row *row);
+void free_reservoir(reservoir *sample);
+
+#endif
@@ -11,8 +11,36 @@
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
+#include <unistd.h>
+#include "agg.h"
+#include "approx.h"
+#include "dataset.h"
+#include "extsort.h"
 #include "list.h"
 #include "functions.h"
+#include "pipeline.h"
+#include "pool.h"
+#include "shard.h"
+#include "scan.h"
+#include "sort.h"
+#include "stats.h"
+#include "table.h"
+
+/**
+ * @brief Ends the program: stops the task pool and prints the statistics if asked to.
+ *
+ * @param print_statistics Whether "--stats" was given.
+ * @param status The exit status.
+ */
+static void finish(int print_statistics, int status)
+{
+    pool_stop();
+    if (print_statistics)
+    {
+        print_stats(stderr);
+    }
+    exit(status);
+}
 
 /**
  * @brief The main function and entry point of the program.
@@ -25,28 +53,199 @@
 int main(int argc, char *argv[])
 {
     // process command line
-    char *data, *filter, *value, *order_by, *order, *limit;
-    parse_arg(argc, argv, &data, &filter, &value, &order_by, &order, &limit);
+    options_t opts;
+    parse_arg(argc, argv, &opts);
+
+    filter_expr *filter = parse_filter(opts.filter, opts.value);
+    agg_query query;
+    approx_query approx;
+    if (opts.approx != NULL)
+    {
+        parse_approx_query(opts.approx, opts.group_by, opts.limit, &approx);
+    }
+    else if (opts.group_by != NULL)
+    {
+        parse_agg_query(opts.group_by, opts.agg, &query);
+    }
+    order_spec order_by;
+    parse_order_spec(opts.order_by, &order_by);
+    output_format format = parse_output_format(opts.output_format);
+    if (format != OUTPUT_CSV && opts.group_by != NULL)
+    {
+        fprintf(stderr, "--group_by writes csv only\n");
+        exit(1);
+    }
+    if (format != OUTPUT_CSV && opts.approx != NULL && approx.kind != APPROX_SAMPLE)
+    {
+        fprintf(stderr, "--approx=%s writes csv only\n", opts.approx);
+        exit(1);
+    }
+    if (opts.after != NULL && (opts.group_by != NULL || opts.approx != NULL || opts.partition != NULL))
+    {
+        fprintf(stderr, "--after pages the rows of a query, not groups, approximations or partitions\n");
+        exit(1);
+    }
+    if (opts.partition != NULL)
+    {
+        // a conversion writes every row, so a query option would be ignored
+        const char *names[] = {"--filter", "--value", "--order_by", "--order", "--limit", "--group_by", "--agg",
+                               "--approx"};
+        const char *values[] = {opts.filter, opts.value, opts.order_by, opts.order, opts.limit, opts.group_by,
+                                opts.agg, opts.approx};
+        for (int i = 0; i < (int)(sizeof(names) / sizeof(names[0])); i++)
+        {
+            if (values[i] != NULL)
+            {
+                fprintf(stderr, "--partition converts every row and cannot be combined with %s\n", names[i]);
+                exit(1);
+            }
+        }
+    }
+
+    // plan the columns that must be parsed for every row; the output columns
+    // are only parsed for the rows that are written
+    unsigned int columns = filter_columns(filter);
+    if (opts.partition != NULL)
+    {
+        columns = COL_ALL;
+    }
+    else if (opts.group_by != NULL)
+    {
+        columns |= agg_columns(&query);
+    }
+    else
+    {
+        columns |= order_spec_columns(&order_by);
+    }
+
+    int data_count = 0;
+    char **data_paths = expand_data_paths(opts.data != NULL ? opts.data : "data.csv", &data_count);
+    const char *data_file = data_paths[0];
+    // every parallel stage runs on the one pool, so --threads caps the whole run
+    pool_start(opts.threads != NULL ? atoi(opts.threads) : (int)sysconf(_SC_NPROCESSORS_ONLN));
+    if (opts.approx != NULL)
+    {
+        // summarize the selected rows in one pass with fixed memory
+        run_approx_query(data_paths, data_count, filter, &approx, opts.order_by, opts.order, format);
+        free_data_paths(data_paths, data_count);
+        free_filter(filter);
+        finish(opts.stats, 0);
+    }
+
+    if (data_count > 1 && opts.group_by == NULL && opts.partition == NULL && opts.after == NULL)
+    {
+        // scan the shards in parallel and merge their sorted rows
+        shard_query(data_paths, data_count, filter, columns, opts.order_by, opts.order, opts.limit,
+                    parse_sort_algorithm(opts.sort), format);
+        free_data_paths(data_paths, data_count);
+        free_filter(filter);
+        finish(opts.stats, 0);
+    }
+
+    if (opts.memory_limit != NULL && opts.group_by == NULL && opts.partition == NULL && data_count == 1 &&
+        is_csv_file(data_file))
+    {
+        if (order_by.count > 0 && !order_spec_is_value(&order_by))
+        {
+            fprintf(stderr, "--memory-limit orders by a single STREAMS, NO_SPOTIFY_PLAYLISTS or NO_APPLE_PLAYLISTS\n");
+            exit(1);
+        }
+        if (opts.after != NULL)
+        {
+            fprintf(stderr, "--after cannot be combined with --memory-limit\n");
+            exit(1);
+        }
+        // sort within the memory budget, spilling sorted runs to disk
+        external_sort_query(data_file, filter, opts.order_by, opts.order, opts.limit,
+                            parse_memory_size(opts.memory_limit), parse_sort_algorithm(opts.sort), format);
+        free_data_paths(data_paths, data_count);
+        free_filter(filter);
+        finish(opts.stats, 0);
+    }
+
+    int keeps_input_order = opts.order_by == NULL && (opts.order == NULL || strcmp(opts.order, "DES") != 0);
+    // with fewer threads than stages the pipeline would exceed --threads, so
+    // the query runs in memory instead
+    if (opts.pipeline && opts.group_by == NULL && opts.partition == NULL && keeps_input_order &&
+        opts.after == NULL && data_count == 1 && is_csv_file(data_file) && pool_threads() >= PIPELINE_THREADS)
+    {
+        // stream the rows through read, parse, filter and write threads
+        pipeline_query(data_file, filter, opts.limit, format);
+        free_data_paths(data_paths, data_count);
+        free_filter(filter);
+        finish(opts.stats, 0);
+    }
 
     // read data
-    const char *data_file = "data.csv";
-    fopen(data_file, "r");
-    node_t *data_file_lines = turn_data_into_list(data_file);
+    double start = stats_now();
+    song_table *table = load_datasets(data_paths, data_count, filter, columns);
+    free_data_paths(data_paths, data_count);
+    stats.rows_loaded = table->rows;
+    stats.load_seconds = stats_now() - start;
+
+    if (opts.partition != NULL)
+    {
+        // convert the data into a directory partitioned by year
+        start = stats_now();
+        int partitions = partition_dataset(table, opts.partition);
+        stats.output_seconds = stats_now() - start;
+        free_table(table);
+        free_filter(filter);
+        finish(opts.stats, partitions < 0);
+    }
 
     // filter data
-    node_t *filtered_lines = NULL;
-    filtered_lines = check_field_in_linked_list(data_file_lines, filter, value, filtered_lines);
+    start = stats_now();
+    int count = 0;
+    int *rows = filter_table(table, filter, &count);
+    stats.rows_selected = count;
+    stats.filter_seconds = stats_now() - start;
 
-    // sort data
-    node_t *sorted_lines = NULL;
-    sorted_lines = merge_sort(filtered_lines, order_by);
-    node_t *limited_result = limit_list(sorted_lines, order, limit);
+    if (opts.group_by != NULL)
+    {
+        // aggregate data
+        start = stats_now();
+        agg_table *groups = aggregate_rows(table, rows, count, &query);
+        stats.groups = groups->size;
+        stats.aggregate_seconds = stats_now() - start;
 
-    // write output
-    write_output_to_file(limited_result, order_by);
+        start = stats_now();
+        write_groups_to_file(groups, &query, opts.order, opts.limit);
+        stats.output_seconds = stats_now() - start;
+        free_agg_table(groups);
+    }
+    else
+    {
+        // sort data, or select the page after the cursor
+        start = stats_now();
+        if (opts.after != NULL)
+        {
+            count = page_rows(table, rows, count, opts.order_by, opts.order, opts.after, opts.limit,
+                              parse_sort_algorithm(opts.sort));
+        }
+        else
+        {
+            sort_rows(table, rows, count, opts.order_by, parse_sort_algorithm(opts.sort));
+            count = limit_rows(rows, count, opts.order, opts.limit);
+        }
+        stats.sort_seconds = stats_now() - start;
 
-    free_list(filtered_lines);
-    free_list(limited_result);
+        // write output
+        start = stats_now();
+        table_materialize(table, COL_OUTPUT | order_spec_columns(&order_by), rows, count);
+        write_rows_to_file(table, rows, count, order_value_name(opts.order_by), format);
+        stats.output_seconds = stats_now() - start;
+        if (opts.after != NULL && count > 0)
+        {
+            // the cursor of the next page
+            char *cursor = format_cursor(table, rows[count - 1], &order_by);
+            printf("%s\n", cursor);
+            free(cursor);
+        }
+    }
 
-    exit(0);
+    free(rows);
+    free_table(table);
+    free_filter(filter);
+    finish(opts.stats, 0);
 }
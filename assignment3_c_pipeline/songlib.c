@@ -0,0 +1,466 @@
+/** @file songlib.c
+ *  @brief Implementation of songlib.h
+ *
+ */
+#include <errno.h>
+#include <stdarg.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/stat.h>
+#include "colfile.h"
+#include "dataset.h"
+#include "emalloc.h"
+#include "scan.h"
+#include "songlib.h"
+#include "sort.h"
+#include "table.h"
+
+#define SA_ERROR_SIZE 256
+#define SA_NAME_COLUMNS 2
+
+/**
+ * @brief An struct that represents an open dataset: a table with every column loaded.
+ */
+struct sa_dataset
+{
+    song_table *table;
+};
+
+/**
+ * @brief An struct that represents the rows a query selected, in result order.
+ *
+ * The columns are gathered on first use; `columns[c]` is the array of
+ * column `c` and `heaps`/`offsets` hold the two name columns. `order_by`
+ * and `descending` are the order of the rows, for paging through them.
+ */
+struct sa_result
+{
+    const sa_dataset *dataset;
+    int *rows;
+    int count;
+    order_spec order_by;
+    int descending;
+    void *columns[COL_NUMBER_OF_FIELDS];
+    char *heaps[SA_NAME_COLUMNS];
+    uint64_t *offsets[SA_NAME_COLUMNS];
+};
+
+static __thread char last_error[SA_ERROR_SIZE];
+
+/**
+ * @brief Records the message sa_last_error returns.
+ */
+static void set_error(const char *format, ...)
+{
+    va_list args;
+    va_start(args, format);
+    vsnprintf(last_error, sizeof(last_error), format, args);
+    va_end(args);
+}
+
+/**
+ * @brief Returns the version of the API the library implements.
+ *
+ * @return int SA_API_VERSION of the library, to be compared with the caller's.
+ */
+int sa_api_version(void)
+{
+    return SA_API_VERSION;
+}
+
+/**
+ * @brief Returns the message of the last error of the calling thread.
+ *
+ * @return const char* The message, or "" if no call has failed.
+ */
+const char *sa_last_error(void)
+{
+    return last_error;
+}
+
+/**
+ * @brief Checks the paths of a dataset before loading them, so that load_datasets cannot end the program.
+ *
+ * @return int 1 if they can be loaded together, 0 (with an error set) otherwise.
+ */
+static int check_data_paths(char *const *paths, int count)
+{
+    int csv_files = 0, colfiles = 0;
+    for (int i = 0; i < count; i++)
+    {
+        struct stat st;
+        if (stat(paths[i], &st) != 0)
+        {
+            set_error("%s: %s", paths[i], strerror(errno));
+            return 0;
+        }
+        csv_files += is_csv_file(paths[i]);
+        colfiles += is_colfile(paths[i]);
+    }
+    if (count > 1 && csv_files != count && colfiles != count)
+    {
+        set_error("data: can only combine csv files or column files, not both or directories");
+        return 0;
+    }
+    return 1;
+}
+
+/**
+ * @brief Opens a dataset, loading every column of it.
+ *
+ * @param data What "--data" accepts: a csv file, a column file, a partitioned
+ *             directory, or a comma-separated list of files and glob patterns.
+ * @return sa_dataset* The dataset, to be closed with sa_close, or NULL on error.
+ */
+sa_dataset *sa_open(const char *data)
+{
+    if (data == NULL || data[strspn(data, ",")] == '\0')
+    {
+        set_error("data names no files");
+        return NULL;
+    }
+    int count = 0;
+    char **paths = expand_data_paths(data, &count);
+    if (!check_data_paths(paths, count))
+    {
+        free_data_paths(paths, count);
+        return NULL;
+    }
+
+    sa_dataset *dataset = (sa_dataset *)emalloc(sizeof(sa_dataset));
+    dataset->table = load_datasets(paths, count, NULL, COL_ALL);
+    free_data_paths(paths, count);
+    return dataset;
+}
+
+/**
+ * @brief Returns the number of songs in a dataset.
+ *
+ * @param dataset The dataset.
+ * @return int The number of rows.
+ */
+int sa_dataset_rows(const sa_dataset *dataset)
+{
+    return dataset->table->rows;
+}
+
+/**
+ * @brief Closes a dataset. Its results must have been freed.
+ *
+ * @param dataset The dataset; may be NULL.
+ */
+void sa_close(sa_dataset *dataset)
+{
+    if (dataset != NULL)
+    {
+        free_table(dataset->table);
+        free(dataset);
+    }
+}
+
+/**
+ * @brief Runs a query against a dataset: filter, sort and limit.
+ *
+ * Several threads may query the same dataset at once.
+ *
+ * @param dataset The dataset.
+ * @param filter The filter names, as "--filter"; NULL selects every row.
+ * @param value The filter values, as "--value".
+ * @param order_by The keys to sort on, as "--order_by"; NULL keeps the data order.
+ * @param order "ASC", "DES" or NULL (ascending).
+ * @param limit The maximum number of rows, as a decimal string; NULL for no limit.
+ * @return sa_result* The result, to be freed with sa_free_result, or NULL on error.
+ */
+sa_result *sa_query(sa_dataset *dataset, const char *filter, const char *value, const char *order_by,
+                    const char *order, const char *limit)
+{
+    char error[SA_ERROR_SIZE];
+    order_spec spec;
+    if (!parse_order_spec_checked(order_by, &spec, error, sizeof(error)))
+    {
+        set_error("%s", error);
+        return NULL;
+    }
+    if (order != NULL && strcmp(order, "ASC") != 0 && strcmp(order, "DES") != 0)
+    {
+        set_error("unknown order: %s", order);
+        return NULL;
+    }
+    if (limit != NULL)
+    {
+        char *end = NULL;
+        strtol(limit, &end, 10);
+        if (end == limit || *end != '\0')
+        {
+            set_error("limit is not a number: %s", limit);
+            return NULL;
+        }
+    }
+    filter_expr *expr = parse_filter_checked(filter, value, error, sizeof(error));
+    if (error[0] != '\0')
+    {
+        set_error("%s", error);
+        return NULL;
+    }
+
+    sa_result *result = (sa_result *)emalloc(sizeof(sa_result));
+    memset(result, 0, sizeof(*result));
+    result->dataset = dataset;
+    result->order_by = spec;
+    result->descending = order != NULL && strcmp(order, "DES") == 0;
+    result->rows = filter_table(dataset->table, expr, &result->count);
+    sort_rows(dataset->table, result->rows, result->count, order_by, SORT_AUTO);
+    result->count = limit_rows(result->rows, result->count, order, limit);
+    free_filter(expr);
+    return result;
+}
+
+/**
+ * @brief Returns one page of a sorted result: the rows after a cursor, up to a limit.
+ *
+ * The result serves as an index of the query: the page starts where a
+ * binary search puts the cursor, so it takes O(log n + page size).
+ *
+ * @param sorted A result, usually of a query without a limit.
+ * @param after A cursor from sa_result_cursor; NULL or "" starts at the first row.
+ * @param limit The maximum number of rows, as a decimal string; NULL for no limit.
+ * @return sa_result* The page, a result in the same order that can be paged
+ *         itself, to be freed with sa_free_result; NULL on error.
+ */
+sa_result *sa_result_page(const sa_result *sorted, const char *after, const char *limit)
+{
+    char error[SA_ERROR_SIZE];
+    row_cursor cursor;
+    if (!parse_cursor_checked(after, &sorted->order_by, &cursor, error, sizeof(error)))
+    {
+        set_error("%s", error);
+        return NULL;
+    }
+    int count = sorted->count;
+    if (limit != NULL)
+    {
+        char *end = NULL;
+        long value = strtol(limit, &end, 10);
+        if (end == limit || *end != '\0')
+        {
+            free_cursor(&cursor);
+            set_error("limit is not a number: %s", limit);
+            return NULL;
+        }
+        count = value < 0 ? 0 : value < count ? (int)value : count;
+    }
+
+    const song_table *table = sorted->dataset->table;
+    int start = search_after(table, sorted->rows, sorted->count, &sorted->order_by, sorted->descending, &cursor);
+    free_cursor(&cursor);
+    if (count > sorted->count - start)
+    {
+        count = sorted->count - start;
+    }
+
+    sa_result *page = (sa_result *)emalloc(sizeof(sa_result));
+    memset(page, 0, sizeof(*page));
+    page->dataset = sorted->dataset;
+    page->order_by = sorted->order_by;
+    page->descending = sorted->descending;
+    page->rows = (int *)emalloc((count > 0 ? count : 1) * sizeof(int));
+    memcpy(page->rows, sorted->rows + start, count * sizeof(int));
+    page->count = count;
+    return page;
+}
+
+/**
+ * @brief Writes the cursor that resumes a result after one of its rows, as "--after" takes it.
+ *
+ * @param result The result.
+ * @param index The position of the row in the result, usually the last one of a page.
+ * @param cursor Where the cursor is written, NUL-terminated, if it fits.
+ * @param size The size of `cursor`.
+ * @return int The length of the cursor, which did not fit if it is `size` or more;
+ *         -1 if `index` is out of range.
+ */
+int sa_result_cursor(const sa_result *result, int index, char *cursor, size_t size)
+{
+    if (index < 0 || index >= result->count)
+    {
+        set_error("row %d is out of range", index);
+        return -1;
+    }
+    char *text = format_cursor(result->dataset->table, result->rows[index], &result->order_by);
+    int length = snprintf(cursor, size, "%s", text);
+    free(text);
+    return length;
+}
+
+/**
+ * @brief Returns the number of rows of a result.
+ *
+ * @param result The result.
+ * @return int The number of rows.
+ */
+int sa_result_rows(const sa_result *result)
+{
+    return result->count;
+}
+
+/**
+ * @brief Returns the row ids of a result: the position of each of its songs in the dataset.
+ *
+ * @param result The result.
+ * @return const int32_t* sa_result_rows ids, valid until the result is freed.
+ */
+const int32_t *sa_result_row_ids(const sa_result *result)
+{
+    return (const int32_t *)result->rows;
+}
+
+/**
+ * @brief Returns the values of a numeric column for the rows of a result.
+ *
+ * The values are gathered into one array the first time a column is asked for.
+ *
+ * @param result The result.
+ * @param column A numeric column.
+ * @return const void* sa_result_rows values, int64_t for SA_STREAMS and int32_t
+ *         otherwise, valid until the result is freed; NULL for a name column.
+ */
+const void *sa_result_column(sa_result *result, sa_column column)
+{
+    if (column < SA_ARTIST_COUNT || column > SA_APPLE_PLAYLISTS)
+    {
+        set_error("column %d is not numeric", (int)column);
+        return NULL;
+    }
+    if (result->columns[column] != NULL)
+    {
+        return result->columns[column];
+    }
+
+    const song_table *table = result->dataset->table;
+    int n = result->count > 0 ? result->count : 1;
+    if (column == SA_STREAMS)
+    {
+        int64_t *values = (int64_t *)emalloc(n * sizeof(int64_t));
+        for (int i = 0; i < result->count; i++)
+        {
+            values[i] = table->streams[result->rows[i]];
+        }
+        result->columns[column] = values;
+        return values;
+    }
+
+    const int *source[] = {[SA_ARTIST_COUNT] = table->artist_count,
+                           [SA_RELEASED_YEAR] = table->released_year,
+                           [SA_RELEASED_MONTH] = table->released_month,
+                           [SA_RELEASED_DAY] = table->released_day,
+                           [SA_SPOTIFY_PLAYLISTS] = table->in_spotify_playlists,
+                           [SA_APPLE_PLAYLISTS] = table->in_apple_playlists};
+    int32_t *values = (int32_t *)emalloc(n * sizeof(int32_t));
+    for (int i = 0; i < result->count; i++)
+    {
+        values[i] = source[column][result->rows[i]];
+    }
+    result->columns[column] = values;
+    return values;
+}
+
+/**
+ * @brief Returns the values of a name column for the rows of a result, packed into one buffer.
+ *
+ * The names are stored one after another, each followed by a NUL; the name
+ * of row `i` starts at `offsets[i]` and ends before `offsets[i + 1] - 1`.
+ * They are gathered the first time a column is asked for.
+ *
+ * @param result The result.
+ * @param column SA_TRACK_NAME or SA_ARTISTS_NAME.
+ * @param offsets Set to sa_result_rows + 1 offsets into the buffer.
+ * @param size Set to the size of the buffer in bytes.
+ * @return const char* The buffer, valid until the result is freed; NULL for a numeric column.
+ */
+const char *sa_result_strings(sa_result *result, sa_column column, const uint64_t **offsets, uint64_t *size)
+{
+    if (column != SA_TRACK_NAME && column != SA_ARTISTS_NAME)
+    {
+        set_error("column %d is not a name", (int)column);
+        return NULL;
+    }
+    char *const *names = column == SA_TRACK_NAME ? result->dataset->table->track_name
+                                                 : result->dataset->table->artists_name;
+    if (result->heaps[column] == NULL)
+    {
+        uint64_t *starts = (uint64_t *)emalloc((result->count + 1) * sizeof(uint64_t));
+        uint64_t total = 0;
+        for (int i = 0; i < result->count; i++)
+        {
+            starts[i] = total;
+            total += strlen(names[result->rows[i]]) + 1;
+        }
+        starts[result->count] = total;
+
+        char *heap = (char *)emalloc(total > 0 ? total : 1);
+        for (int i = 0; i < result->count; i++)
+        {
+            memcpy(heap + starts[i], names[result->rows[i]], starts[i + 1] - starts[i]);
+        }
+        result->heaps[column] = heap;
+        result->offsets[column] = starts;
+    }
+    *offsets = result->offsets[column];
+    *size = result->offsets[column][result->count];
+    return result->heaps[column];
+}
+
+/**
+ * @brief Fills in one song of a result, for iterating over the rows.
+ *
+ * @param result The result.
+ * @param index The position of the song in the result.
+ * @param song The song to fill in.
+ * @return int 0, or -1 if `index` is out of range.
+ */
+int sa_result_song(const sa_result *result, int index, sa_song *song)
+{
+    if (index < 0 || index >= result->count)
+    {
+        set_error("row %d is out of range", index);
+        return -1;
+    }
+    const song_table *table = result->dataset->table;
+    int row = result->rows[index];
+    song->track_name = table->track_name[row];
+    song->artists_name = table->artists_name[row];
+    song->artist_count = table->artist_count[row];
+    song->released_year = table->released_year[row];
+    song->released_month = table->released_month[row];
+    song->released_day = table->released_day[row];
+    song->in_spotify_playlists = table->in_spotify_playlists[row];
+    song->streams = table->streams[row];
+    song->in_apple_playlists = table->in_apple_playlists[row];
+    return 0;
+}
+
+/**
+ * @brief Frees a result and the arrays returned for it.
+ *
+ * @param result The result; may be NULL.
+ */
+void sa_free_result(sa_result *result)
+{
+    if (result == NULL)
+    {
+        return;
+    }
+    for (int i = 0; i < COL_NUMBER_OF_FIELDS; i++)
+    {
+        free(result->columns[i]);
+    }
+    for (int i = 0; i < SA_NAME_COLUMNS; i++)
+    {
+        free(result->heaps[i]);
+        free(result->offsets[i]);
+    }
+    free(result->rows);
+    free(result);
+}
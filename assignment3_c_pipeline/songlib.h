@@ -0,0 +1,94 @@
+/** @file songlib.h
+ *  @brief The C API of libsong_analyzer.so, the query engine as a shared library.
+ *
+ * A dataset is opened once (every column is loaded) and can then be queried
+ * any number of times:
+ *
+ *     sa_dataset *data = sa_open("data.csv");
+ *     sa_result *result = sa_query(data, "ARTIST", "Drake", "STREAMS", "DES", "10");
+ *     const int64_t *streams = sa_result_column(result, SA_STREAMS);
+ *     ...
+ *     sa_free_result(result);
+ *     sa_close(data);
+ *
+ * The arguments of sa_open and sa_query take the same values as "--data",
+ * "--filter", "--value", "--order_by", "--order" and "--limit". The
+ * results are returned as arrays owned by the result, with one entry per
+ * row in result order, so callers can wrap them without copying (see
+ * songlib.py). A result can also be paged through with keyset cursors,
+ * using sa_result_page and sa_result_cursor. Functions that fail return NULL (or -1) and leave a
+ * message for sa_last_error; a data file that is corrupt still ends the
+ * program, as it does on the command line.
+ *
+ * Only this header is part of the API. SA_API_VERSION changes whenever an
+ * existing declaration does; additions keep it.
+ */
+#ifndef _SONGLIB_H_
+#define _SONGLIB_H_
+
+#include <stddef.h>
+#include <stdint.h>
+
+#define SA_API_VERSION 1
+
+/**
+ * @brief The columns of a result, in csv field order.
+ *
+ * SA_STREAMS is int64_t; the other numeric columns are int32_t and the two
+ * names are strings (see sa_result_strings).
+ */
+typedef enum
+{
+    SA_TRACK_NAME,
+    SA_ARTISTS_NAME,
+    SA_ARTIST_COUNT,
+    SA_RELEASED_YEAR,
+    SA_RELEASED_MONTH,
+    SA_RELEASED_DAY,
+    SA_SPOTIFY_PLAYLISTS,
+    SA_STREAMS,
+    SA_APPLE_PLAYLISTS
+} sa_column;
+
+/**
+ * @brief An struct that represents one song of a result, as filled in by sa_result_song.
+ *
+ * The names point into the dataset and stay valid until it is closed.
+ */
+typedef struct
+{
+    const char *track_name;
+    const char *artists_name;
+    int32_t artist_count;
+    int32_t released_year;
+    int32_t released_month;
+    int32_t released_day;
+    int32_t in_spotify_playlists;
+    int64_t streams;
+    int32_t in_apple_playlists;
+} sa_song;
+
+typedef struct sa_dataset sa_dataset;
+typedef struct sa_result sa_result;
+
+/**
+ * Function protypes of the library API.
+ *
+ */
+int sa_api_version(void);
+const char *sa_last_error(void);
+sa_dataset *sa_open(const char *data);
+int sa_dataset_rows(const sa_dataset *dataset);
+void sa_close(sa_dataset *dataset);
+sa_result *sa_query(sa_dataset *dataset, const char *filter, const char *value, const char *order_by,
+                    const char *order, const char *limit);
+sa_result *sa_result_page(const sa_result *sorted, const char *after, const char *limit);
+int sa_result_cursor(const sa_result *result, int index, char *cursor, size_t size);
+int sa_result_rows(const sa_result *result);
+const int32_t *sa_result_row_ids(const sa_result *result);
+const void *sa_result_column(sa_result *result, sa_column column);
+const char *sa_result_strings(sa_result *result, sa_column column, const uint64_t **offsets, uint64_t *size);
+int sa_result_song(const sa_result *result, int index, sa_song *song);
+void sa_free_result(sa_result *result);
+
+#endif
@@ -0,0 +1,298 @@
+#!/usr/bin/env python
+# -*- coding: utf-8 -*-
+"""
+
+Python bindings for libsong_analyzer.so, the C query engine (see songlib.h).
+
+Queries run entirely in C. Their results are exposed as memoryviews over
+the arrays the library returns, so no Python object is created per row
+unless the rows are iterated:
+
+    import songlib
+
+    data = songlib.Dataset("data.csv")
+    result = data.query(filter="ARTIST", value="Drake", order_by="STREAMS", order="DES", limit=10)
+    streams = result.column("streams")              # memoryview of int64, no copy
+    heap, offsets = result.strings("artists_name")  # memoryviews of bytes and uint64
+    for song in result:                             # one Song per row
+        print(song.track_name, song.streams)
+
+A result sorted once can be paged through with keyset cursors, each page
+found by binary search:
+
+    ranking = data.query(order_by="YEAR:DES,STREAMS:DES")
+    page = ranking.page(limit=50)
+    page = ranking.page(after=page.cursor(), limit=50)  # the next 50 rows
+
+The memoryviews keep their result (and its dataset) alive. Build the
+library with `make lib`; SONGLIB_PATH overrides where it is loaded from.
+
+"""
+
+import ctypes
+import os
+from typing import Iterator, NamedTuple, Optional, Tuple, Union
+
+API_VERSION = 1
+
+COLUMNS = ["track_name", "artists_name", "artist_count", "released_year", "released_month", "released_day",
+           "in_spotify_playlists", "streams", "in_apple_playlists"]
+NAME_COLUMNS = ["track_name", "artists_name"]
+
+
+class SongLibError(Exception):
+    """
+    SongLibError reports a call the library refused, with its message.
+    """
+
+
+class Song(NamedTuple):
+    """
+    Song represents one row of a result.
+    """
+    track_name: str
+    artists_name: str
+    artist_count: int
+    released_year: int
+    released_month: int
+    released_day: int
+    in_spotify_playlists: int
+    streams: int
+    in_apple_playlists: int
+
+
+class _SongStruct(ctypes.Structure):
+    """
+    _SongStruct mirrors sa_song.
+    """
+    _fields_ = [("track_name", ctypes.c_char_p),
+                ("artists_name", ctypes.c_char_p),
+                ("artist_count", ctypes.c_int32),
+                ("released_year", ctypes.c_int32),
+                ("released_month", ctypes.c_int32),
+                ("released_day", ctypes.c_int32),
+                ("in_spotify_playlists", ctypes.c_int32),
+                ("streams", ctypes.c_int64),
+                ("in_apple_playlists", ctypes.c_int32)]
+
+
+def _load_library() -> ctypes.CDLL:
+    """
+    Load libsong_analyzer.so and declare the signatures of its functions.
+
+    Returns:
+    ctypes.CDLL: The library.
+    """
+    path = os.environ.get("SONGLIB_PATH",
+                          os.path.join(os.path.dirname(os.path.abspath(__file__)), "libsong_analyzer.so"))
+    lib = ctypes.CDLL(path)
+    lib.sa_api_version.restype = ctypes.c_int
+    if lib.sa_api_version() != API_VERSION:
+        raise SongLibError(f"{path} implements API version {lib.sa_api_version()}, expected {API_VERSION}")
+
+    string = ctypes.c_char_p
+    lib.sa_last_error.restype = string
+    lib.sa_open.argtypes = [string]
+    lib.sa_open.restype = ctypes.c_void_p
+    lib.sa_dataset_rows.argtypes = [ctypes.c_void_p]
+    lib.sa_close.argtypes = [ctypes.c_void_p]
+    lib.sa_query.argtypes = [ctypes.c_void_p, string, string, string, string, string]
+    lib.sa_query.restype = ctypes.c_void_p
+    lib.sa_result_page.argtypes = [ctypes.c_void_p, string, string]
+    lib.sa_result_page.restype = ctypes.c_void_p
+    lib.sa_result_cursor.argtypes = [ctypes.c_void_p, ctypes.c_int, ctypes.c_char_p, ctypes.c_size_t]
+    lib.sa_result_rows.argtypes = [ctypes.c_void_p]
+    lib.sa_result_row_ids.argtypes = [ctypes.c_void_p]
+    lib.sa_result_row_ids.restype = ctypes.c_void_p
+    lib.sa_result_column.argtypes = [ctypes.c_void_p, ctypes.c_int]
+    lib.sa_result_column.restype = ctypes.c_void_p
+    lib.sa_result_strings.argtypes = [ctypes.c_void_p, ctypes.c_int, ctypes.POINTER(ctypes.c_void_p),
+                                      ctypes.POINTER(ctypes.c_uint64)]
+    lib.sa_result_strings.restype = ctypes.c_void_p
+    lib.sa_result_song.argtypes = [ctypes.c_void_p, ctypes.c_int, ctypes.POINTER(_SongStruct)]
+    lib.sa_free_result.argtypes = [ctypes.c_void_p]
+    return lib
+
+
+_lib = _load_library()
+
+
+def _error() -> SongLibError:
+    """
+    Build the exception for the last call that failed in this thread.
+    """
+    return SongLibError(_lib.sa_last_error().decode())
+
+
+def _encode(value: Optional[Union[str, int]]) -> Optional[bytes]:
+    """
+    Convert an argument into the C string the library expects (None stays NULL).
+    """
+    return None if value is None else str(value).encode()
+
+
+def _view(address: int, count: int, ctype, owner) -> memoryview:
+    """
+    Wrap `count` values of type `ctype` at `address` in a memoryview, without copying them.
+
+    Parameters:
+    - address (int): Where the values are.
+    - count (int): How many values there are.
+    - ctype: Their ctypes type.
+    - owner: The object that owns the memory; the memoryview keeps it alive.
+
+    Returns:
+    memoryview: A read-only view with the format of `ctype`.
+    """
+    array = (ctype * count).from_address(address)
+    array._owner = owner
+    return memoryview(array).cast("B").cast(ctype._type_).toreadonly()
+
+
+class Dataset:
+    """
+    Dataset represents data opened with every column loaded, ready to be queried many times.
+    """
+    def __init__(self, data: str) -> None:
+        """
+        Open a dataset.
+
+        Parameters:
+        - data (str): What --data accepts: a csv file, a column file, a partitioned directory or a
+          comma-separated list of files and glob patterns.
+        """
+        self._handle = _lib.sa_open(_encode(data))
+        if not self._handle:
+            raise _error()
+
+    def __del__(self) -> None:
+        if getattr(self, "_handle", None):
+            _lib.sa_close(self._handle)
+            self._handle = None
+
+    def __len__(self) -> int:
+        return _lib.sa_dataset_rows(self._handle)
+
+    def query(self, filter: Optional[str] = None, value: Optional[str] = None, order_by: Optional[str] = None,
+              order: Optional[str] = None, limit: Optional[int] = None) -> "Result":
+        """
+        Run a query: filter, sort and limit. The arguments take the values of the matching options.
+
+        Returns:
+        Result: The selected rows.
+        """
+        handle = _lib.sa_query(self._handle, _encode(filter), _encode(value), _encode(order_by), _encode(order),
+                               _encode(limit))
+        if not handle:
+            raise _error()
+        return Result(self, handle)
+
+
+class Result:
+    """
+    Result represents the rows a query selected, in result order.
+    """
+    def __init__(self, dataset: Dataset, handle: int) -> None:
+        # the dataset holds the names the rows point to
+        self._dataset = dataset
+        self._handle = handle
+
+    def __del__(self) -> None:
+        if getattr(self, "_handle", None):
+            _lib.sa_free_result(self._handle)
+            self._handle = None
+
+    def __len__(self) -> int:
+        return _lib.sa_result_rows(self._handle)
+
+    def row_ids(self) -> memoryview:
+        """
+        Return the position of each row in the dataset, as int32 values.
+        """
+        return _view(_lib.sa_result_row_ids(self._handle), len(self), ctypes.c_int32, self)
+
+    def column(self, name: str) -> memoryview:
+        """
+        Return a numeric column of the rows: int64 values for "streams", int32 otherwise.
+
+        Parameters:
+        - name (str): A column name from COLUMNS other than the names.
+
+        Returns:
+        memoryview: The values, one per row.
+        """
+        if name not in COLUMNS or name in NAME_COLUMNS:
+            raise SongLibError(f"not a numeric column: {name}")
+        address = _lib.sa_result_column(self._handle, COLUMNS.index(name))
+        if not address:
+            raise _error()
+        return _view(address, len(self), ctypes.c_int64 if name == "streams" else ctypes.c_int32, self)
+
+    def strings(self, name: str) -> Tuple[memoryview, memoryview]:
+        """
+        Return a name column of the rows as one buffer of NUL-terminated UTF-8 names.
+
+        The name of row i is heap[offsets[i]:offsets[i + 1] - 1].
+
+        Parameters:
+        - name (str): "track_name" or "artists_name".
+
+        Returns:
+        tuple: The buffer (bytes) and len(self) + 1 offsets (uint64) into it.
+        """
+        if name not in NAME_COLUMNS:
+            raise SongLibError(f"not a name column: {name}")
+        offsets = ctypes.c_void_p()
+        size = ctypes.c_uint64()
+        address = _lib.sa_result_strings(self._handle, COLUMNS.index(name), ctypes.byref(offsets),
+                                         ctypes.byref(size))
+        if not address:
+            raise _error()
+        return (_view(address, size.value, ctypes.c_char, self),
+                _view(offsets.value, len(self) + 1, ctypes.c_uint64, self))
+
+    def page(self, after: Optional[str] = None, limit: Optional[int] = None) -> "Result":
+        """
+        Return the rows after a cursor, up to a limit, as a result in the same order.
+
+        Parameters:
+        - after (str): A cursor from cursor() (or from --after); None starts at the first row.
+        - limit (int): The most rows to return; None returns every row left.
+
+        Returns:
+        Result: The page.
+        """
+        handle = _lib.sa_result_page(self._handle, _encode(after), _encode(limit))
+        if not handle:
+            raise _error()
+        return Result(self._dataset, handle)
+
+    def cursor(self, index: int = -1) -> str:
+        """
+        Return the cursor that resumes the rows after one of them, by default the last.
+
+        Parameters:
+        - index (int): The position of the row; negative values count from the end.
+
+        Returns:
+        str: The cursor, as page() and --after take it.
+        """
+        if index < 0:
+            index += len(self)
+        size = 64
+        while True:
+            buffer = ctypes.create_string_buffer(size)
+            length = _lib.sa_result_cursor(self._handle, index, buffer, size)
+            if length < 0:
+                raise _error()
+            if length < size:
+                return buffer.value.decode()
+            size = length + 1
+
+    def __iter__(self) -> Iterator[Song]:
+        song = _SongStruct()
+        for i in range(len(self)):
+            _lib.sa_result_song(self._handle, i, ctypes.byref(song))
+            yield Song(song.track_name.decode(), song.artists_name.decode(), song.artist_count,
+                       song.released_year, song.released_month, song.released_day, song.in_spotify_playlists,
+                       song.streams, song.in_apple_playlists)
@@ -0,0 +1,1208 @@
+/** @file sort.c
+ *  @brief Implementation of sort.h
+ *
+ * Rows are sorted through an array of (key, row id) entries, with each
+ * row's key encoded once before sorting so that the sorts compare keys
+ * without looking at the table:
+ *
+ * - When every key of "--order_by" is numeric, the keys are packed into one
+ *   unsigned integer whose unsigned order is the order of the list: each
+ *   value is mapped to an unsigned value of its width (flipping the sign bit
+ *   keeps the numeric order), inverted for a DES key, and the keys are
+ *   concatenated, the first in the most significant bits. Streams take 64
+ *   bits and the other fields 32, so up to 64 bits use sort_entry (radix or
+ *   merge sorted) and up to 128 bits wide_sort_entry.
+ * - Otherwise each key is encoded into a byte string whose memcmp order is
+ *   the order of the list: numbers as above, big-endian, and names as their
+ *   bytes followed by a NUL (a name never holds one, so a shorter name that
+ *   is a prefix of a longer one sorts first), every byte inverted for a DES
+ *   key. These are sorted by up to 8 bytes at a time, taken where the keys
+ *   differ, and then within each run of ties on the bytes that follow.
+ *
+ * All the sorts are stable. The packed byte string of a row also serves as
+ * the key of a pagination cursor (see page_rows).
+ */
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "emalloc.h"
+#include "sort.h"
+#include "table.h"
+
+/**
+ * @brief The number of value fields (see order_field), which come first.
+ */
+#define VALUE_FIELDS 3
+
+/**
+ * @brief How many bytes of the packed keys are searched at a time for bytes that differ between rows.
+ */
+#define PREFIX_SEARCH_BYTES 64
+
+/**
+ * @brief Runs of packed keys shorter than this are sorted by comparing the keys.
+ */
+#define PREFIX_MIN_RUN 16
+
+/**
+ * @brief The names "--order_by" uses for the fields, indexed by order_field.
+ */
+static const char *field_names[] = {"STREAMS", "NO_SPOTIFY_PLAYLISTS", "NO_APPLE_PLAYLISTS", "YEAR", "MONTH", "DAY",
+                                    "ARTIST_COUNT", "TRACK_NAME", "ARTIST"};
+
+/**
+ * @brief Converts the "--sort" argument into a sort algorithm.
+ *
+ * @param name "AUTO", "MERGE" or "RADIX"; NULL means "AUTO".
+ * @return sort_algorithm The algorithm to use.
+ */
+sort_algorithm parse_sort_algorithm(const char *name)
+{
+    if (name == NULL || strcmp(name, "AUTO") == 0)
+    {
+        return SORT_AUTO;
+    }
+    if (strcmp(name, "MERGE") == 0)
+    {
+        return SORT_MERGE;
+    }
+    if (strcmp(name, "RADIX") == 0)
+    {
+        return SORT_RADIX;
+    }
+    fprintf(stderr, "unknown sort algorithm: %s\n", name);
+    exit(1);
+}
+
+
+/**
+ * @brief Looks up the value field an "--order_by" argument names.
+ *
+ * @param order_by "STREAMS", "NO_SPOTIFY_PLAYLISTS" or "NO_APPLE_PLAYLISTS"; NULL means no ordering.
+ * @param field Set to the field to sort on.
+ * @return int 1 if the name is known, 0 otherwise.
+ */
+int lookup_order_by(const char *order_by, order_field *field)
+{
+    *field = ORDER_NONE;
+    if (order_by == NULL)
+    {
+        return 1;
+    }
+    for (int i = 0; i < VALUE_FIELDS; i++)
+    {
+        if (strcmp(order_by, field_names[i]) == 0)
+        {
+            *field = (order_field)i;
+            return 1;
+        }
+    }
+    return 0;
+}
+
+/**
+ * @brief Converts a single "--order_by" value field into the field to sort on.
+ *
+ * Used where only a value field makes sense (aggregates, approximate
+ * queries, the external sort); an unknown name ends the program.
+ *
+ * @param order_by "STREAMS", "NO_SPOTIFY_PLAYLISTS" or "NO_APPLE_PLAYLISTS"; NULL means no ordering.
+ * @return order_field The field to sort on.
+ */
+order_field parse_order_by(const char *order_by)
+{
+    order_field field;
+    if (!lookup_order_by(order_by, &field))
+    {
+        fprintf(stderr, "unknown order_by field: %s\n", order_by);
+        exit(1);
+    }
+    return field;
+}
+
+/**
+ * @brief Parses an "--order_by" list, reporting errors to the caller.
+ *
+ * The list holds up to MAX_ORDER_KEYS comma-separated keys, each a field
+ * name optionally followed by ":ASC" (the default) or ":DES", e.g.
+ * "YEAR:DES,STREAMS:DES,TRACK_NAME". Besides the value fields, the fields
+ * are YEAR, MONTH, DAY, ARTIST_COUNT, TRACK_NAME and ARTIST.
+ *
+ * @param order_by The list, or NULL for no ordering.
+ * @param spec The parsed list.
+ * @param error Set to a description of the first error, or to "" when there is none.
+ * @param size The size of `error`.
+ * @return int 1 if the list is valid, 0 otherwise.
+ */
+int parse_order_spec_checked(const char *order_by, order_spec *spec, char *error, size_t size)
+{
+    spec->count = 0;
+    error[0] = '\0';
+    if (order_by == NULL)
+    {
+        return 1;
+    }
+
+    char *list = strdup(order_by);
+    char *rest = NULL;
+    for (char *item = strtok_r(list, ",", &rest); item != NULL && error[0] == '\0'; item = strtok_r(NULL, ",", &rest))
+    {
+        char *direction = strchr(item, ':');
+        if (direction != NULL)
+        {
+            *direction++ = '\0';
+        }
+        order_key key = {ORDER_NONE, direction != NULL && strcmp(direction, "DES") == 0};
+        for (int i = 0; i < (int)(sizeof(field_names) / sizeof(field_names[0])); i++)
+        {
+            if (strcmp(item, field_names[i]) == 0)
+            {
+                key.field = (order_field)i;
+            }
+        }
+
+        if (spec->count == MAX_ORDER_KEYS)
+        {
+            snprintf(error, size, "--order_by lists more than %d keys", MAX_ORDER_KEYS);
+        }
+        else if (key.field == ORDER_NONE)
+        {
+            snprintf(error, size, "unknown order_by field: %s", item);
+        }
+        else if (direction != NULL && !key.descending && strcmp(direction, "ASC") != 0)
+        {
+            snprintf(error, size, "unknown order_by direction: %s", direction);
+        }
+        else
+        {
+            spec->keys[spec->count++] = key;
+        }
+    }
+    free(list);
+    if (spec->count == 0 && error[0] == '\0')
+    {
+        snprintf(error, size, "unknown order_by field: %s", order_by);
+    }
+    return error[0] == '\0';
+}
+
+/**
+ * @brief Parses an "--order_by" list (see parse_order_spec_checked); an invalid list ends the program.
+ *
+ * @param order_by The list, or NULL for no ordering.
+ * @param spec The parsed list.
+ */
+void parse_order_spec(const char *order_by, order_spec *spec)
+{
+    char error[256];
+    if (!parse_order_spec_checked(order_by, spec, error, sizeof(error)))
+    {
+        fprintf(stderr, "%s\n", error);
+        exit(1);
+    }
+}
+
+/**
+ * @brief Returns the columns the keys of an "--order_by" list are read from.
+ *
+ * @param spec The list.
+ * @return unsigned int The COL_* flags of the columns.
+ */
+unsigned int order_spec_columns(const order_spec *spec)
+{
+    unsigned int columns = 0;
+    for (int i = 0; i < spec->count; i++)
+    {
+        columns |= order_columns(spec->keys[i].field);
+    }
+    return columns;
+}
+
+/**
+ * @brief Tells whether an "--order_by" list is a single ascending value field, as parse_order_by accepts.
+ *
+ * @param spec The list.
+ * @return int 1 if it is, 0 otherwise.
+ */
+int order_spec_is_value(const order_spec *spec)
+{
+    return spec->count == 1 && !spec->keys[0].descending && spec->keys[0].field < VALUE_FIELDS;
+}
+
+/**
+ * @brief Returns the value field whose value is written with each row of a query ordered by a list.
+ *
+ * That is the first value field of the list, so "YEAR:DES,STREAMS:DES"
+ * writes the streams.
+ *
+ * @param order_by A valid "--order_by" list, or NULL.
+ * @return const char* The name of the field, or NULL if the list has none.
+ */
+const char *order_value_name(const char *order_by)
+{
+    order_spec spec;
+    parse_order_spec(order_by, &spec);
+    for (int i = 0; i < spec.count; i++)
+    {
+        if (spec.keys[i].field < VALUE_FIELDS)
+        {
+            return field_names[spec.keys[i].field];
+        }
+    }
+    return NULL;
+}
+
+/**
+ * @brief Returns the value of a numeric field of a row.
+ */
+static long int field_value(const song_table *table, int row, order_field field)
+{
+    switch (field)
+    {
+    case ORDER_STREAMS:
+        return table->streams[row];
+    case ORDER_SPOTIFY_PLAYLISTS:
+        return table->in_spotify_playlists[row];
+    case ORDER_APPLE_PLAYLISTS:
+        return table->in_apple_playlists[row];
+    case ORDER_YEAR:
+        return table->released_year[row];
+    case ORDER_MONTH:
+        return table->released_month[row];
+    case ORDER_DAY:
+        return table->released_day[row];
+    case ORDER_ARTIST_COUNT:
+        return table->artist_count[row];
+    default:
+        return 0;
+    }
+}
+
+/**
+ * @brief Returns the sort key of a row, as an unsigned value with the same order as the field.
+ *
+ * Flipping the sign bit maps the signed range onto the unsigned range in order.
+ *
+ * @param table The table the row belongs to.
+ * @param row The row id.
+ * @param field The field to sort on; a name field gives 0.
+ * @return uint64_t The sort key.
+ */
+uint64_t sort_key(const song_table *table, int row, order_field field)
+{
+    return (uint64_t)field_value(table, row, field) ^ ((uint64_t)1 << 63);
+}
+
+/**
+ * @brief Returns the column an "--order_by" field is read from.
+ *
+ * @param field The field.
+ * @return unsigned int The COL_* flag of the field's column, 0 for ORDER_NONE.
+ */
+unsigned int order_columns(order_field field)
+{
+    switch (field)
+    {
+    case ORDER_STREAMS:
+        return COL_STREAMS;
+    case ORDER_SPOTIFY_PLAYLISTS:
+        return COL_SPOTIFY_PLAYLISTS;
+    case ORDER_APPLE_PLAYLISTS:
+        return COL_APPLE_PLAYLISTS;
+    case ORDER_YEAR:
+        return COL_RELEASED_YEAR;
+    case ORDER_MONTH:
+        return COL_RELEASED_MONTH;
+    case ORDER_DAY:
+        return COL_RELEASED_DAY;
+    case ORDER_ARTIST_COUNT:
+        return COL_ARTIST_COUNT;
+    case ORDER_TRACK_NAME:
+        return COL_TRACK_NAME;
+    case ORDER_ARTISTS_NAME:
+        return COL_ARTISTS_NAME;
+    default:
+        return 0;
+    }
+}
+
+/**
+ * @brief Returns the name a name field of a row holds, or NULL for a numeric field.
+ */
+static const char *field_name(const song_table *table, int row, order_field field)
+{
+    if (field == ORDER_TRACK_NAME)
+    {
+        return table->track_name[row];
+    }
+    if (field == ORDER_ARTISTS_NAME)
+    {
+        return table->artists_name[row];
+    }
+    return NULL;
+}
+
+/**
+ * @brief Compares two rows, possibly of different tables, key by key.
+ *
+ * Used where keys are compared once per row rather than in a sort's inner
+ * loop, such as the merge of sorted shards.
+ *
+ * @param spec The "--order_by" list.
+ * @param a The table of the first row.
+ * @param row_a The first row.
+ * @param b The table of the second row.
+ * @param row_b The second row.
+ * @return int Negative, zero or positive as the first row comes before, ties with or comes after the second.
+ */
+int compare_rows(const order_spec *spec, const song_table *a, int row_a, const song_table *b, int row_b)
+{
+    for (int i = 0; i < spec->count; i++)
+    {
+        order_field field = spec->keys[i].field;
+        int c;
+        const char *name_a = field_name(a, row_a, field);
+        if (name_a != NULL)
+        {
+            c = strcmp(name_a, field_name(b, row_b, field));
+        }
+        else
+        {
+            uint64_t x = sort_key(a, row_a, field);
+            uint64_t y = sort_key(b, row_b, field);
+            c = (x > y) - (x < y);
+        }
+        if (c != 0)
+        {
+            return spec->keys[i].descending ? -c : c;
+        }
+    }
+    return 0;
+}
+
+/**
+ * @brief Returns the number of bits a numeric field takes in a packed key, or 0 for a name field.
+ */
+static int field_bits(order_field field)
+{
+    if (field == ORDER_TRACK_NAME || field == ORDER_ARTISTS_NAME)
+    {
+        return 0;
+    }
+    return field == ORDER_STREAMS ? 64 : 32;
+}
+
+/**
+ * @brief Returns the number of bits the keys of a list take packed into an integer, or -1 if one is a name.
+ */
+static int numeric_key_bits(const order_spec *spec)
+{
+    int bits = 0;
+    for (int i = 0; i < spec->count; i++)
+    {
+        if (field_bits(spec->keys[i].field) == 0)
+        {
+            return -1;
+        }
+        bits += field_bits(spec->keys[i].field);
+    }
+    return bits;
+}
+
+/**
+ * @brief Returns the value of a numeric key of a row mapped to an unsigned value of field_bits bits in the same order.
+ */
+static uint64_t field_key(const song_table *table, int row, const order_key *key)
+{
+    int bits = field_bits(key->field);
+    uint64_t mask = bits == 64 ? ~(uint64_t)0 : ((uint64_t)1 << bits) - 1;
+    uint64_t value = ((uint64_t)field_value(table, row, key->field) ^ ((uint64_t)1 << (bits - 1))) & mask;
+    return key->descending ? ~value & mask : value;
+}
+
+/**
+ * @brief Packs the numeric keys of a row into one integer, the first key in the most significant bits.
+ */
+static unsigned __int128 numeric_key(const song_table *table, int row, const order_spec *spec)
+{
+    unsigned __int128 key = 0;
+    for (int i = 0; i < spec->count; i++)
+    {
+        key = (key << field_bits(spec->keys[i].field)) | field_key(table, row, &spec->keys[i]);
+    }
+    return key;
+}
+
+/**
+ * @brief Returns the number of bytes the packed key of a row takes.
+ */
+static int packed_key_size(const song_table *table, int row, const order_spec *spec)
+{
+    int size = 0;
+    for (int i = 0; i < spec->count; i++)
+    {
+        const char *name = field_name(table, row, spec->keys[i].field);
+        size += name != NULL ? (int)strlen(name) + 1 : field_bits(spec->keys[i].field) / 8;
+    }
+    return size;
+}
+
+/**
+ * @brief Encodes the keys of a row into a byte string whose memcmp order is the order of the list.
+ */
+static void pack_key(const song_table *table, int row, const order_spec *spec, unsigned char *out)
+{
+    for (int i = 0; i < spec->count; i++)
+    {
+        const order_key *key = &spec->keys[i];
+        const char *name = field_name(table, row, key->field);
+        if (name != NULL)
+        {
+            unsigned char flip = key->descending ? 0xff : 0;
+            do
+            {
+                *out++ = (unsigned char)*name ^ flip;
+            } while (*name++ != '\0');
+            continue;
+        }
+        uint64_t value = field_key(table, row, key);
+        for (int shift = field_bits(key->field) - 8; shift >= 0; shift -= 8)
+        {
+            *out++ = (unsigned char)(value >> shift);
+        }
+    }
+}
+
+/**
+ * @brief Defines a stable, bottom-up merge sort of an entry type.
+ *
+ * @param name The name of the sort function.
+ * @param type The entry type.
+ * @param less An expression of two entry pointers `a` and `b`, true when `a` comes before `b`.
+ */
+#define DEFINE_MERGE_SORT(name, type, less)                                                        \
+    void name(type *entries, int count)                                                            \
+    {                                                                                              \
+        if (count < 2)                                                                             \
+        {                                                                                          \
+            return;                                                                                \
+        }                                                                                          \
+        type *buffer = (type *)emalloc(count * sizeof(type));                                      \
+        type *src = entries;                                                                       \
+        type *dst = buffer;                                                                        \
+        for (int width = 1; width < count; width *= 2)                                             \
+        {                                                                                          \
+            for (int lo = 0; lo < count; lo += 2 * width)                                          \
+            {                                                                                      \
+                int mid = lo + width < count ? lo + width : count;                                 \
+                int hi = lo + 2 * width < count ? lo + 2 * width : count;                          \
+                int i = lo, j = mid, k = lo;                                                       \
+                while (i < mid && j < hi)                                                          \
+                {                                                                                  \
+                    /* take from the left run on ties to stay stable */                            \
+                    const type *a = &src[j], *b = &src[i];                                         \
+                    dst[k++] = (less) ? src[j++] : src[i++];                                       \
+                }                                                                                  \
+                while (i < mid)                                                                    \
+                {                                                                                  \
+                    dst[k++] = src[i++];                                                           \
+                }                                                                                  \
+                while (j < hi)                                                                     \
+                {                                                                                  \
+                    dst[k++] = src[j++];                                                           \
+                }                                                                                  \
+            }                                                                                      \
+            type *tmp = src;                                                                       \
+            src = dst;                                                                             \
+            dst = tmp;                                                                             \
+        }                                                                                          \
+        if (src != entries)                                                                        \
+        {                                                                                          \
+            memcpy(entries, src, count * sizeof(type));                                            \
+        }                                                                                          \
+        free(buffer);                                                                              \
+    }
+
+/**
+ * @brief Defines a stable LSD radix sort of an entry type by its unsigned `key`, one byte per pass.
+ *
+ * The histograms of all the bytes are taken in one read of the keys, and a
+ * pass over a byte that is the same in every key is skipped, so small keys
+ * such as playlist counts, or the high bytes of a year, cost no pass.
+ *
+ * @param name The name of the sort function.
+ * @param type The entry type.
+ * @param bytes The number of bytes of its key.
+ */
+#define DEFINE_RADIX_SORT(name, type, bytes)                                                       \
+    void name(type *entries, int count)                                                            \
+    {                                                                                              \
+        if (count < 2)                                                                             \
+        {                                                                                          \
+            return;                                                                                \
+        }                                                                                          \
+        int histogram[bytes][256];                                                                 \
+        memset(histogram, 0, sizeof(histogram));                                                   \
+        for (int i = 0; i < count; i++)                                                            \
+        {                                                                                          \
+            for (int b = 0; b < (bytes); b++)                                                      \
+            {                                                                                      \
+                histogram[b][(int)(entries[i].key >> (8 * b)) & 0xff]++;                           \
+            }                                                                                      \
+        }                                                                                          \
+        type *buffer = (type *)emalloc(count * sizeof(type));                                      \
+        type *src = entries;                                                                       \
+        type *dst = buffer;                                                                        \
+        for (int b = 0; b < (bytes); b++)                                                          \
+        {                                                                                          \
+            int *counts = histogram[b];                                                            \
+            if (counts[(int)(src[0].key >> (8 * b)) & 0xff] == count)                              \
+            {                                                                                      \
+                continue;                                                                          \
+            }                                                                                      \
+            int offset = 0;                                                                        \
+            for (int d = 0; d < 256; d++)                                                          \
+            {                                                                                      \
+                int c = counts[d];                                                                 \
+                counts[d] = offset;                                                                \
+                offset += c;                                                                       \
+            }                                                                                      \
+            for (int i = 0; i < count; i++)                                                        \
+            {                                                                                      \
+                dst[counts[(int)(src[i].key >> (8 * b)) & 0xff]++] = src[i];                       \
+            }                                                                                      \
+            type *tmp = src;                                                                       \
+            src = dst;                                                                             \
+            dst = tmp;                                                                             \
+        }                                                                                          \
+        if (src != entries)                                                                        \
+        {                                                                                          \
+            memcpy(entries, src, count * sizeof(type));                                            \
+        }                                                                                          \
+        free(buffer);                                                                              \
+    }
+
+/**
+ * @brief Tells whether a packed key comes before another.
+ */
+static int packed_less(const packed_sort_entry *a, const packed_sort_entry *b)
+{
+    int length = a->length < b->length ? a->length : b->length;
+    int c = memcmp(a->key, b->key, length);
+    return c < 0 || (c == 0 && a->length < b->length);
+}
+
+/**
+ * @brief Sorts entries, wide entries and packed entries by key with stable merge sorts,
+ * and the first two with stable radix sorts.
+ */
+DEFINE_MERGE_SORT(merge_sort_entries, sort_entry, a->key < b->key)
+DEFINE_MERGE_SORT(merge_sort_wide_entries, wide_sort_entry, a->key < b->key)
+DEFINE_MERGE_SORT(merge_sort_packed_entries, packed_sort_entry, packed_less(a, b))
+DEFINE_RADIX_SORT(radix_sort_entries, sort_entry, 8)
+DEFINE_RADIX_SORT(radix_sort_wide_entries, wide_sort_entry, 16)
+
+/**
+ * @brief Sorts rows by numeric keys that fit in 64 bits.
+ */
+static void sort_numeric_rows(const song_table *table, int *rows, int count, const order_spec *spec, int radix)
+{
+    sort_entry *entries = (sort_entry *)emalloc(count * sizeof(sort_entry));
+    for (int i = 0; i < count; i++)
+    {
+        entries[i].key = (uint64_t)numeric_key(table, rows[i], spec);
+        entries[i].row = rows[i];
+    }
+    if (radix)
+    {
+        radix_sort_entries(entries, count);
+    }
+    else
+    {
+        merge_sort_entries(entries, count);
+    }
+    for (int i = 0; i < count; i++)
+    {
+        rows[i] = entries[i].row;
+    }
+    free(entries);
+}
+
+/**
+ * @brief Sorts rows by numeric keys that fit in 128 bits.
+ */
+static void sort_wide_rows(const song_table *table, int *rows, int count, const order_spec *spec, int radix)
+{
+    wide_sort_entry *entries = (wide_sort_entry *)emalloc(count * sizeof(wide_sort_entry));
+    for (int i = 0; i < count; i++)
+    {
+        entries[i].key = numeric_key(table, rows[i], spec);
+        entries[i].row = rows[i];
+    }
+    if (radix)
+    {
+        radix_sort_wide_entries(entries, count);
+    }
+    else
+    {
+        merge_sort_wide_entries(entries, count);
+    }
+    for (int i = 0; i < count; i++)
+    {
+        rows[i] = entries[i].row;
+    }
+    free(entries);
+}
+
+/**
+ * @brief Sorts packed keys that are equal before byte `from`, by the bytes from there on.
+ *
+ * Bytes that are the same in every key of the range, such as the high
+ * bytes of a year or of a stream count, or a prefix all the names share,
+ * are skipped, and the next 8 (among PREFIX_SEARCH_BYTES) become an
+ * integer key that is sorted like a numeric one. When two of those keys
+ * differ they give the order of the packed keys, since every byte before
+ * the last one taken is either taken or equal in all keys; bytes past the
+ * end of a key count as 0, which keeps a name before the longer names it
+ * begins. Runs of equal integer keys are then sorted from the next byte on,
+ * and short runs by comparing their keys.
+ *
+ * @param packed The packed keys.
+ * @param order The indexes in `packed` of the keys to sort, in place.
+ * @param count The number of keys.
+ * @param from The first byte that may differ.
+ * @param radix Whether to radix sort the integer keys.
+ */
+static void sort_packed_range(const packed_sort_entry *packed, int *order, int count, int from, int radix)
+{
+    if (count < PREFIX_MIN_RUN)
+    {
+        packed_sort_entry run[PREFIX_MIN_RUN];
+        for (int i = 0; i < count; i++)
+        {
+            run[i] = packed[order[i]];
+            run[i].row = order[i];
+        }
+        merge_sort_packed_entries(run, count);
+        for (int i = 0; i < count; i++)
+        {
+            order[i] = run[i].row;
+        }
+        return;
+    }
+
+    // one pass marks the bytes that differ from the first key; a byte past
+    // the end of some keys but not others is marked as well
+    unsigned char first[PREFIX_SEARCH_BYTES] = {0};
+    unsigned char differs[PREFIX_SEARCH_BYTES] = {0};
+    const packed_sort_entry *head = &packed[order[0]];
+    int first_length = head->length - from < PREFIX_SEARCH_BYTES ? head->length - from : PREFIX_SEARCH_BYTES;
+    memcpy(first, head->key + from, first_length > 0 ? first_length : 0);
+    int longest = head->length;
+    for (int i = 1; i < count; i++)
+    {
+        const packed_sort_entry *e = &packed[order[i]];
+        int length = e->length - from < PREFIX_SEARCH_BYTES ? e->length - from : PREFIX_SEARCH_BYTES;
+        for (int p = 0; p < length; p++)
+        {
+            differs[p] |= e->key[from + p] ^ first[p];
+        }
+        if (length != first_length)
+        {
+            int same = length < first_length ? length : first_length;
+            same = same > 0 ? same : 0;
+            memset(differs + same, 1, PREFIX_SEARCH_BYTES - same);
+        }
+        longest = e->length > longest ? e->length : longest;
+    }
+
+    int positions[8];
+    int taken = 0;
+    int next = from;
+    for (int p = 0; p < PREFIX_SEARCH_BYTES && taken < 8; p++)
+    {
+        if (differs[p])
+        {
+            positions[taken++] = from + p;
+        }
+        next = from + p + 1;
+    }
+    if (next >= longest && taken == 0)
+    {
+        // every key is the same
+        return;
+    }
+    while (taken < 8)
+    {
+        positions[taken++] = next - 1;
+    }
+
+    sort_entry *entries = (sort_entry *)emalloc(count * sizeof(sort_entry));
+    for (int i = 0; i < count; i++)
+    {
+        const packed_sort_entry *e = &packed[order[i]];
+        uint64_t prefix = 0;
+        for (int b = 0; b < 8; b++)
+        {
+            prefix = (prefix << 8) | (positions[b] < e->length ? e->key[positions[b]] : 0);
+        }
+        entries[i].key = prefix;
+        entries[i].row = order[i];
+    }
+    if (radix && count >= RADIX_SORT_THRESHOLD)
+    {
+        radix_sort_entries(entries, count);
+    }
+    else
+    {
+        merge_sort_entries(entries, count);
+    }
+    for (int i = 0; i < count; i++)
+    {
+        order[i] = entries[i].row;
+    }
+
+    for (int lo = 0, hi; lo < count; lo = hi)
+    {
+        hi = lo + 1;
+        while (hi < count && entries[hi].key == entries[lo].key)
+        {
+            hi++;
+        }
+        if (hi - lo > 1 && next < longest)
+        {
+            sort_packed_range(packed, order + lo, hi - lo, next, radix);
+        }
+    }
+    free(entries);
+}
+
+/**
+ * @brief Sorts rows by packed keys, all encoded into one buffer first.
+ */
+static void sort_packed_rows(const song_table *table, int *rows, int count, const order_spec *spec, int radix)
+{
+    packed_sort_entry *packed = (packed_sort_entry *)emalloc(count * sizeof(packed_sort_entry));
+    size_t size = 0;
+    for (int i = 0; i < count; i++)
+    {
+        packed[i].length = packed_key_size(table, rows[i], spec);
+        packed[i].row = rows[i];
+        size += packed[i].length;
+    }
+    unsigned char *keys = (unsigned char *)emalloc(size > 0 ? size : 1);
+    unsigned char *key = keys;
+    int *order = (int *)emalloc(count * sizeof(int));
+    for (int i = 0; i < count; i++)
+    {
+        pack_key(table, rows[i], spec, key);
+        packed[i].key = key;
+        key += packed[i].length;
+        order[i] = i;
+    }
+
+    sort_packed_range(packed, order, count, 0, radix);
+    for (int i = 0; i < count; i++)
+    {
+        rows[i] = packed[order[i]].row;
+    }
+    free(order);
+    free(keys);
+    free(packed);
+}
+
+/**
+ * @brief Sorts row ids in the order of an "--order_by" list, keeping the input order of ties.
+ *
+ * The keys are radix sorted (with SORT_AUTO, when there are at least
+ * RADIX_SORT_THRESHOLD rows) or merge sorted; keys that include a name are
+ * sorted by a prefix that way and then by the whole key within ties.
+ *
+ * @param table The table the rows belong to.
+ * @param rows The row ids to sort, in place.
+ * @param count The number of row ids.
+ * @param order_by The "--order_by" list; NULL leaves the rows unchanged.
+ * @param algorithm The algorithm to use.
+ */
+void sort_rows(const song_table *table, int *rows, int count, const char *order_by, sort_algorithm algorithm)
+{
+    order_spec spec;
+    parse_order_spec(order_by, &spec);
+    if (spec.count == 0 || count < 2)
+    {
+        return;
+    }
+
+    int radix = algorithm == SORT_RADIX || (algorithm == SORT_AUTO && count >= RADIX_SORT_THRESHOLD);
+    int bits = numeric_key_bits(&spec);
+    if (bits < 0)
+    {
+        sort_packed_rows(table, rows, count, &spec, radix);
+    }
+    else if (bits <= 64)
+    {
+        sort_numeric_rows(table, rows, count, &spec, radix);
+    }
+    else if (bits <= 128)
+    {
+        sort_wide_rows(table, rows, count, &spec, radix);
+    }
+    else
+    {
+        // too many numeric keys for one integer: compare them as bytes
+        sort_packed_rows(table, rows, count, &spec, radix);
+    }
+}
+
+/**
+ * @brief Applies "--order" and "--limit" to ascending sorted row ids, in place.
+ *
+ * "ASC" (or no order) keeps the first `limit` rows. "DES" keeps the last `limit`
+ * rows in reverse order.
+ *
+ * @param rows The sorted row ids.
+ * @param count The number of row ids.
+ * @param order "ASC", "DES" or NULL.
+ * @param limit The maximum number of rows to keep; NULL keeps them all.
+ * @return int The number of rows kept.
+ */
+int limit_rows(int *rows, int count, const char *order, const char *limit)
+{
+    if (order != NULL && strcmp(order, "DES") == 0)
+    {
+        for (int i = 0, j = count - 1; i < j; i++, j--)
+        {
+            int tmp = rows[i];
+            rows[i] = rows[j];
+            rows[j] = tmp;
+        }
+    }
+
+    if (limit != NULL)
+    {
+        int lim = atoi(limit);
+        if (lim < count)
+        {
+            count = lim > 0 ? lim : 0;
+        }
+    }
+    return count;
+}
+
+/**
+ * @brief Packs the key of a row (see pack_key) into a buffer, replacing the buffer when the key does not fit.
+ *
+ * @return int The length of the key.
+ */
+static int pack_row_key(const song_table *table, int row, const order_spec *spec, unsigned char **buffer,
+                        int *capacity)
+{
+    int length = packed_key_size(table, row, spec);
+    if (length > *capacity)
+    {
+        free(*buffer);
+        *capacity = 2 * length;
+        *buffer = (unsigned char *)emalloc(*capacity);
+    }
+    pack_key(table, row, spec, *buffer);
+    return length;
+}
+
+/**
+ * @brief Compares the packed key and id of a row with a cursor, in ascending order.
+ *
+ * @return int Negative, zero or positive as the row comes before, is or comes after the row of the cursor.
+ */
+static int compare_cursor(const unsigned char *key, int length, int row, const row_cursor *cursor)
+{
+    int c = memcmp(key, cursor->key, length < cursor->length ? length : cursor->length);
+    if (c == 0)
+    {
+        c = (length > cursor->length) - (length < cursor->length);
+    }
+    if (c == 0)
+    {
+        c = (row > cursor->row) - (row < cursor->row);
+    }
+    return c;
+}
+
+/**
+ * @brief Parses an "--after" cursor, reporting an invalid one instead of ending the program.
+ *
+ * A cursor is the packed key (see pack_key) of the last row of a page in
+ * hexadecimal, a '.' and the row id; "" is the start of the result.
+ *
+ * @param text The cursor, as format_cursor writes it.
+ * @param spec The "--order_by" list of the query, to check the length of the key.
+ * @param cursor The parsed cursor, to be freed with free_cursor.
+ * @param error Set to the message of the error, or "" if there is none.
+ * @param size The size of `error`.
+ * @return int 1 if the cursor is valid, 0 otherwise.
+ */
+int parse_cursor_checked(const char *text, const order_spec *spec, row_cursor *cursor, char *error, size_t size)
+{
+    cursor->key = NULL;
+    cursor->length = 0;
+    cursor->row = -1;
+    error[0] = '\0';
+    if (text == NULL || text[0] == '\0')
+    {
+        return 1;
+    }
+
+    const char *dot = strchr(text, '.');
+    int digits = dot != NULL ? (int)(dot - text) : 0;
+    char *end = NULL;
+    long row = dot != NULL ? strtol(dot + 1, &end, 10) : -1;
+    int bits = numeric_key_bits(spec);
+    if (dot == NULL || end == dot + 1 || *end != '\0' || row < 0 || row > INT32_MAX || digits % 2 != 0 ||
+        (int)strspn(text, "0123456789abcdef") != digits)
+    {
+        snprintf(error, size, "invalid cursor: %s", text);
+        return 0;
+    }
+    if ((bits >= 0 && digits != bits / 4) || (bits < 0 && digits == 0))
+    {
+        snprintf(error, size, "cursor does not match --order_by: %s", text);
+        return 0;
+    }
+
+    cursor->length = digits / 2;
+    cursor->key = (unsigned char *)emalloc(cursor->length > 0 ? cursor->length : 1);
+    for (int i = 0; i < cursor->length; i++)
+    {
+        unsigned int byte = 0;
+        sscanf(text + 2 * i, "%2x", &byte);
+        cursor->key[i] = (unsigned char)byte;
+    }
+    cursor->row = (int)row;
+    return 1;
+}
+
+/**
+ * @brief Frees the key of a cursor.
+ *
+ * @param cursor The cursor.
+ */
+void free_cursor(row_cursor *cursor)
+{
+    free(cursor->key);
+    cursor->key = NULL;
+}
+
+/**
+ * @brief Returns the packed key of a row (see pack_key).
+ *
+ * Rows compare in the order of the list as their keys compare with memcmp,
+ * a key that is a prefix of another first.
+ *
+ * @param table The table the row belongs to, with the columns of the keys loaded.
+ * @param row The row.
+ * @param spec The "--order_by" list.
+ * @param length Set to the length of the key.
+ * @return unsigned char* The key, to be freed.
+ */
+unsigned char *row_sort_key(const song_table *table, int row, const order_spec *spec, int *length)
+{
+    *length = packed_key_size(table, row, spec);
+    unsigned char *key = (unsigned char *)emalloc(*length > 0 ? *length : 1);
+    pack_key(table, row, spec, key);
+    return key;
+}
+
+/**
+ * @brief Writes the cursor that resumes a result after a row.
+ *
+ * @param table The table the row belongs to, with the columns of the keys loaded.
+ * @param row The last row of a page.
+ * @param spec The "--order_by" list of the query.
+ * @return char* The cursor, to be freed.
+ */
+char *format_cursor(const song_table *table, int row, const order_spec *spec)
+{
+    int length;
+    unsigned char *key = row_sort_key(table, row, spec, &length);
+
+    char *text = (char *)emalloc(2 * length + 16);
+    for (int i = 0; i < length; i++)
+    {
+        sprintf(text + 2 * i, "%02x", key[i]);
+    }
+    sprintf(text + 2 * length, ".%d", row);
+    free(key);
+    return text;
+}
+
+/**
+ * @brief Finds where a sorted result resumes after a cursor, by binary search.
+ *
+ * @param table The table the rows belong to.
+ * @param rows The row ids, in result order.
+ * @param count The number of row ids.
+ * @param spec The "--order_by" list the rows are sorted by.
+ * @param descending Whether the result is in "--order=DES" order.
+ * @param after The cursor.
+ * @return int The position of the first row after the cursor, or `count`.
+ */
+int search_after(const song_table *table, const int *rows, int count, const order_spec *spec, int descending,
+                 const row_cursor *after)
+{
+    if (after->row < 0)
+    {
+        return 0;
+    }
+    unsigned char *key = NULL;
+    int capacity = 0;
+    int low = 0, high = count;
+    while (low < high)
+    {
+        int middle = low + (high - low) / 2;
+        int length = pack_row_key(table, rows[middle], spec, &key, &capacity);
+        int c = compare_cursor(key, length, rows[middle], after);
+        if (descending ? c < 0 : c > 0)
+        {
+            high = middle;
+        }
+        else
+        {
+            low = middle + 1;
+        }
+    }
+    free(key);
+    return low;
+}
+
+/**
+ * @brief Returns whether a row comes before another in result order, ties broken by row id.
+ */
+static int page_precedes(const song_table *table, const order_spec *spec, int descending, int a, int b)
+{
+    int c = compare_rows(spec, table, a, table, b);
+    if (c == 0)
+    {
+        c = (a > b) - (a < b);
+    }
+    return descending ? c > 0 : c < 0;
+}
+
+/**
+ * @brief Moves a row down a heap whose top is the row that comes last in result order.
+ */
+static void page_sift_down(const song_table *table, const order_spec *spec, int descending, int *heap, int size,
+                           int i)
+{
+    while (1)
+    {
+        int last = i;
+        for (int child = 2 * i + 1; child <= 2 * i + 2 && child < size; child++)
+        {
+            if (page_precedes(table, spec, descending, heap[last], heap[child]))
+            {
+                last = child;
+            }
+        }
+        if (last == i)
+        {
+            return;
+        }
+        int tmp = heap[i];
+        heap[i] = heap[last];
+        heap[last] = tmp;
+        i = last;
+    }
+}
+
+/**
+ * @brief Selects one page of a query's result: the rows after a cursor, in result order, up to a limit.
+ *
+ * The rows after the cursor are found by comparing their packed keys with
+ * it. When the page is shorter than what remains, it is selected with a
+ * bounded heap of `limit` rows, in O(n log limit) rather than sorting
+ * every row; otherwise the rows left are sorted.
+ *
+ * @param table The table the rows belong to.
+ * @param rows The selected row ids, in ascending order; the page replaces them.
+ * @param count The number of row ids.
+ * @param order_by The "--order_by" list; NULL for the input order.
+ * @param order "ASC", "DES" or NULL.
+ * @param after The "--after" cursor (see format_cursor); "" starts at the first row.
+ * @param limit The maximum number of rows to keep; NULL keeps them all.
+ * @param algorithm The algorithm to sort with.
+ * @return int The number of rows of the page.
+ */
+int page_rows(const song_table *table, int *rows, int count, const char *order_by, const char *order,
+              const char *after, const char *limit, sort_algorithm algorithm)
+{
+    order_spec spec;
+    parse_order_spec(order_by, &spec);
+    row_cursor cursor;
+    char error[256];
+    if (!parse_cursor_checked(after, &spec, &cursor, error, sizeof(error)))
+    {
+        fprintf(stderr, "%s\n", error);
+        exit(1);
+    }
+    int descending = order != NULL && strcmp(order, "DES") == 0;
+
+    int kept = count;
+    if (cursor.row >= 0)
+    {
+        unsigned char *key = NULL;
+        int capacity = 0;
+        kept = 0;
+        for (int i = 0; i < count; i++)
+        {
+            int length = pack_row_key(table, rows[i], &spec, &key, &capacity);
+            int c = compare_cursor(key, length, rows[i], &cursor);
+            if (descending ? c < 0 : c > 0)
+            {
+                rows[kept++] = rows[i];
+            }
+        }
+        free(key);
+    }
+    free_cursor(&cursor);
+
+    int page = limit != NULL ? atoi(limit) : kept;
+    page = page > 0 ? page : 0;
+    if (spec.count == 0 || page >= kept)
+    {
+        sort_rows(table, rows, kept, order_by, algorithm);
+        return limit_rows(rows, kept, order, limit);
+    }
+
+    // keep the first `page` rows in a heap topped by the last of them
+    int size = 0;
+    for (int i = 0; i < kept; i++)
+    {
+        if (size < page)
+        {
+            int j = size++;
+            rows[j] = rows[i];
+            while (j > 0 && page_precedes(table, &spec, descending, rows[(j - 1) / 2], rows[j]))
+            {
+                int tmp = rows[j];
+                rows[j] = rows[(j - 1) / 2];
+                rows[(j - 1) / 2] = tmp;
+                j = (j - 1) / 2;
+            }
+        }
+        else if (size > 0 && page_precedes(table, &spec, descending, rows[i], rows[0]))
+        {
+            rows[0] = rows[i];
+            page_sift_down(table, &spec, descending, rows, size, 0);
+        }
+    }
+
+    // take the heap apart from its last row to its first
+    for (int end = size - 1; end > 0; end--)
+    {
+        int tmp = rows[0];
+        rows[0] = rows[end];
+        rows[end] = tmp;
+        page_sift_down(table, &spec, descending, rows, end, 0);
+    }
+    return size;
+}
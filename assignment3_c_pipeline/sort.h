@@ -0,0 +1,148 @@
+/** @file sort.h
+ *  @brief Function prototypes for sorting the selected rows of a song table.
+ *
+ */
+#ifndef _SORT_H_
+#define _SORT_H_
+
+#include <stddef.h>
+#include <stdint.h>
+#include "table.h"
+
+/**
+ * @brief Inputs with at least this many rows are radix sorted when the algorithm is SORT_AUTO.
+ */
+#define RADIX_SORT_THRESHOLD 1024
+
+/**
+ * @brief The algorithms sort_rows can use.
+ */
+typedef enum
+{
+    SORT_AUTO,
+    SORT_MERGE,
+    SORT_RADIX
+} sort_algorithm;
+
+/**
+ * @brief The most keys "--order_by" can list.
+ */
+#define MAX_ORDER_KEYS 8
+
+/**
+ * @brief The fields --order_by can name.
+ *
+ * The first three are the "value" fields: a query that orders by one of them
+ * writes its value with each row, and aggregates and approximate queries
+ * can use them as weights. The others can only be sort keys.
+ */
+typedef enum
+{
+    ORDER_NONE = -1,
+    ORDER_STREAMS,
+    ORDER_SPOTIFY_PLAYLISTS,
+    ORDER_APPLE_PLAYLISTS,
+    ORDER_YEAR,
+    ORDER_MONTH,
+    ORDER_DAY,
+    ORDER_ARTIST_COUNT,
+    ORDER_TRACK_NAME,
+    ORDER_ARTISTS_NAME
+} order_field;
+
+/**
+ * @brief An struct that represents one key of an "--order_by" list, e.g. "YEAR:DES".
+ */
+typedef struct
+{
+    order_field field;
+    int descending;
+} order_key;
+
+/**
+ * @brief An struct that represents a parsed "--order_by" list, e.g. "YEAR:DES,STREAMS:DES,TRACK_NAME".
+ *
+ * Rows are ordered by the first key, ties by the second, and so on; rows
+ * equal in every key keep their input order. `count` is 0 without "--order_by".
+ */
+typedef struct
+{
+    int count;
+    order_key keys[MAX_ORDER_KEYS];
+} order_spec;
+
+/**
+ * @brief An struct that pairs the sort key of a row with its row id.
+ */
+typedef struct
+{
+    uint64_t key;
+    int row;
+} sort_entry;
+
+/**
+ * @brief An struct that pairs a 128-bit sort key with its row id, for lists of numeric keys too wide for sort_entry.
+ */
+typedef struct
+{
+    unsigned __int128 key;
+    int row;
+} wide_sort_entry;
+
+/**
+ * @brief An struct that pairs a packed sort key with its row id.
+ *
+ * The key is a byte string whose memcmp order is the order of the row (see
+ * sort.c); it is used when the keys include a name.
+ */
+typedef struct
+{
+    const unsigned char *key;
+    int length;
+    int row;
+} packed_sort_entry;
+
+/**
+ * @brief An struct that represents a keyset pagination cursor: the packed sort key and row id of the last row of a page.
+ *
+ * `row` is -1 for the start of a result.
+ */
+typedef struct
+{
+    unsigned char *key;
+    int length;
+    int row;
+} row_cursor;
+
+/**
+ * Function protypes associated with sorting.
+ *
+ */
+sort_algorithm parse_sort_algorithm(const char *name);
+int lookup_order_by(const char *order_by, order_field *field);
+order_field parse_order_by(const char *order_by);
+int parse_order_spec_checked(const char *order_by, order_spec *spec, char *error, size_t size);
+void parse_order_spec(const char *order_by, order_spec *spec);
+unsigned int order_spec_columns(const order_spec *spec);
+int order_spec_is_value(const order_spec *spec);
+const char *order_value_name(const char *order_by);
+uint64_t sort_key(const song_table *table, int row, order_field field);
+unsigned int order_columns(order_field field);
+int compare_rows(const order_spec *spec, const song_table *a, int row_a, const song_table *b, int row_b);
+void merge_sort_entries(sort_entry *entries, int count);
+void radix_sort_entries(sort_entry *entries, int count);
+void merge_sort_wide_entries(wide_sort_entry *entries, int count);
+void radix_sort_wide_entries(wide_sort_entry *entries, int count);
+void merge_sort_packed_entries(packed_sort_entry *entries, int count);
+void sort_rows(const song_table *table, int *rows, int count, const char *order_by, sort_algorithm algorithm);
+int limit_rows(int *rows, int count, const char *order, const char *limit);
+int parse_cursor_checked(const char *text, const order_spec *spec, row_cursor *cursor, char *error, size_t size);
+void free_cursor(row_cursor *cursor);
+unsigned char *row_sort_key(const song_table *table, int row, const order_spec *spec, int *length);
+char *format_cursor(const song_table *table, int row, const order_spec *spec);
+int search_after(const song_table *table, const int *rows, int count, const order_spec *spec, int descending,
+                 const row_cursor *after);
+int page_rows(const song_table *table, int *rows, int count, const char *order_by, const char *order,
+              const char *after, const char *limit, sort_algorithm algorithm);
+
+#endif
@@ -0,0 +1,119 @@
+/** @file stats.c
+ *  @brief Implementation of stats.h
+ *
+ */
+#include <pthread.h>
+#include <stddef.h>
+#include <stdio.h>
+#include <time.h>
+#include "stats.h"
+
+__thread stats_t stats;
+
+static pthread_mutex_t merge_lock = PTHREAD_MUTEX_INITIALIZER;
+
+/**
+ * @brief Returns a monotonic timestamp in seconds, for timing the stages.
+ *
+ * @return double The current time in seconds.
+ */
+double stats_now(void)
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+/**
+ * @brief Adds the counters and times of one thread's statistics to another's.
+ *
+ * Safe to call from several threads at once.
+ *
+ * @param into The statistics to add to, e.g. the main thread's `&stats`.
+ * @param from The statistics to add.
+ */
+void stats_merge(stats_t *into, const stats_t *from)
+{
+    size_t counters = offsetof(stats_t, scan_seconds) / sizeof(long long);
+    size_t timers = (sizeof(stats_t) - offsetof(stats_t, scan_seconds)) / sizeof(double);
+    long long *counter = &into->rows_loaded;
+    double *timer = &into->scan_seconds;
+
+    pthread_mutex_lock(&merge_lock);
+    for (size_t i = 0; i < counters; i++)
+    {
+        counter[i] += (&from->rows_loaded)[i];
+    }
+    for (size_t i = 0; i < timers; i++)
+    {
+        timer[i] += (&from->scan_seconds)[i];
+    }
+    pthread_mutex_unlock(&merge_lock);
+}
+
+/**
+ * @brief Prints the collected statistics, one "name: value" pair per line.
+ *
+ * @param out The stream to print to.
+ */
+void print_stats(FILE *out)
+{
+    fprintf(out, "rows loaded: %lld\n", stats.rows_loaded);
+    if (stats.rows_rejected > 0)
+    {
+        fprintf(out, "rows rejected: %lld\n", stats.rows_rejected);
+    }
+    if (stats.partitions_read + stats.partitions_pruned > 0)
+    {
+        fprintf(out, "partitions read: %lld\n", stats.partitions_read);
+        fprintf(out, "partitions pruned: %lld\n", stats.partitions_pruned);
+    }
+    if (stats.bytes_read > 0)
+    {
+        fprintf(out, "bytes read: %lld\n", stats.bytes_read);
+    }
+    if (stats.bytes_decompressed > 0)
+    {
+        fprintf(out, "bytes decompressed: %lld\n", stats.bytes_decompressed);
+    }
+    if (stats.blocks_scanned + stats.blocks_skipped > 0)
+    {
+        fprintf(out, "blocks skipped: %lld of %lld\n", stats.blocks_skipped,
+                stats.blocks_scanned + stats.blocks_skipped);
+    }
+    fprintf(out, "rows selected: %lld\n", stats.rows_selected);
+    fprintf(out, "load time: %.3f ms\n", stats.load_seconds * 1e3);
+    fprintf(out, "filter time: %.3f ms\n", stats.filter_seconds * 1e3);
+    fprintf(out, "sort time: %.3f ms\n", stats.sort_seconds * 1e3);
+    if (stats.groups > 0)
+    {
+        fprintf(out, "groups: %lld\n", stats.groups);
+        fprintf(out, "aggregate time: %.3f ms\n", stats.aggregate_seconds * 1e3);
+    }
+    if (stats.runs_spilled > 0)
+    {
+        fprintf(out, "runs spilled: %lld (%lld bytes)\n", stats.runs_spilled, stats.bytes_spilled);
+        fprintf(out, "merge passes: %lld\n", stats.merge_passes);
+    }
+    fprintf(out, "output time: %.3f ms\n", stats.output_seconds * 1e3);
+    if (stats.pipeline_full_waits + stats.pipeline_empty_waits > 0)
+    {
+        fprintf(out, "pipeline waits: %lld on a full ring, %lld on an empty ring\n", stats.pipeline_full_waits,
+                stats.pipeline_empty_waits);
+    }
+    if (stats.pool_tasks > 0)
+    {
+        fprintf(out, "scheduler: %lld threads, %lld tasks, %lld steals, %.3f ms idle\n", stats.pool_threads,
+                stats.pool_tasks, stats.pool_steals, stats.pool_idle_seconds * 1e3);
+    }
+    if (stats.values_scanned > 0 && stats.scan_seconds > 0)
+    {
+        fprintf(out, "numeric scan: %lld values, %.3f ms, %.2f Gvalues/s\n", stats.values_scanned,
+                stats.scan_seconds * 1e3, stats.values_scanned / stats.scan_seconds / 1e9);
+    }
+    if (stats.artist_bytes_scanned > 0 && stats.artist_scan_seconds > 0)
+    {
+        fprintf(out, "artist scan: %lld bytes, %.3f ms, %.2f GB/s\n", stats.artist_bytes_scanned,
+                stats.artist_scan_seconds * 1e3, stats.artist_bytes_scanned / stats.artist_scan_seconds / 1e9);
+    }
+}
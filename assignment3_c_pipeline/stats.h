@@ -0,0 +1,61 @@
+/** @file stats.h
+ *  @brief Counters and timers reported by the "--stats" option.
+ *
+ */
+#ifndef _STATS_H_
+#define _STATS_H_
+
+#include <stdio.h>
+
+/**
+ * @brief An struct that collects what a run of the analyzer did and how long it took.
+ *
+ * All the counters come before all the timers (stats_merge relies on it).
+ */
+typedef struct
+{
+    long long rows_loaded;
+    long long rows_rejected;
+    long long rows_selected;
+    long long values_scanned;
+    long long groups;
+    long long partitions_read;
+    long long partitions_pruned;
+    long long blocks_scanned;
+    long long blocks_skipped;
+    long long bytes_read;
+    long long bytes_decompressed;
+    long long runs_spilled;
+    long long bytes_spilled;
+    long long merge_passes;
+    long long pipeline_full_waits;
+    long long pipeline_empty_waits;
+    long long artist_bytes_scanned;
+    long long pool_threads;
+    long long pool_tasks;
+    long long pool_steals;
+    double scan_seconds;
+    double artist_scan_seconds;
+    double load_seconds;
+    double filter_seconds;
+    double sort_seconds;
+    double aggregate_seconds;
+    double output_seconds;
+    double pool_idle_seconds;
+} stats_t;
+
+/**
+ * @brief The statistics of the calling thread. Worker threads merge theirs
+ * into the main thread's with stats_merge before they exit.
+ */
+extern __thread stats_t stats;
+
+/**
+ * Function protypes associated with the statistics.
+ *
+ */
+double stats_now(void);
+void stats_merge(stats_t *into, const stats_t *from);
+void print_stats(FILE *out);
+
+#endif
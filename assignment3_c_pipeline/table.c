@@ -0,0 +1,363 @@
+/** @file table.c
+ *  @brief Implementation of table.h
+ *
+ */
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "csv.h"
+#include "emalloc.h"
+#include "list.h"
+#include "table.h"
+
+/**
+ * @brief Allocates a song table with room for the given number of rows.
+ *
+ * The numeric column arrays are allocated but not initialised, the string
+ * columns are all NULL, `lines` and `heap` are NULL and every column is
+ * marked as loaded.
+ *
+ * @param rows The number of rows.
+ * @return song_table* A pointer to the new table.
+ */
+song_table *new_table(int rows)
+{
+    song_table *table = (song_table *)emalloc(sizeof(song_table));
+
+    // emalloc(0) may legitimately return NULL, so always allocate a slot
+    size_t n = rows > 0 ? rows : 1;
+    table->rows = rows;
+    table->columns = COL_ALL;
+    table->lines = NULL;
+    table->heap = NULL;
+    table->zones = NULL;
+    table->zone_count = 0;
+    table->artists_buffer = NULL;
+    table->artists_buffer_size = 0;
+    table->artists_buffer_owned = 0;
+    table->track_name = (char **)emalloc(n * sizeof(char *));
+    table->artists_name = (char **)emalloc(n * sizeof(char *));
+    table->artist_count = (int *)emalloc(n * sizeof(int));
+    table->released_year = (int *)emalloc(n * sizeof(int));
+    table->released_month = (int *)emalloc(n * sizeof(int));
+    table->released_day = (int *)emalloc(n * sizeof(int));
+    table->in_spotify_playlists = (int *)emalloc(n * sizeof(int));
+    table->streams = (long int *)emalloc(n * sizeof(long int));
+    table->in_apple_playlists = (int *)emalloc(n * sizeof(int));
+    memset(table->track_name, 0, n * sizeof(char *));
+    memset(table->artists_name, 0, n * sizeof(char *));
+
+    return table;
+}
+
+/**
+ * @brief Parses a csv integer field the way "%d" would, stopping at the first non-digit.
+ *
+ * @param p The start of the field.
+ * @param value Set to the parsed value (0 if there are no digits).
+ * @return const char* The first character after the digits.
+ */
+static const char *parse_number(const char *p, long int *value)
+{
+    long int v = 0;
+    int negative = 0;
+    while (*p == ' ' || *p == '\t')
+    {
+        p++;
+    }
+    if (*p == '-' || *p == '+')
+    {
+        negative = *p == '-';
+        p++;
+    }
+    while (*p >= '0' && *p <= '9')
+    {
+        v = v * 10 + (*p - '0');
+        p++;
+    }
+    *value = negative ? -v : v;
+    return p;
+}
+
+/**
+ * @brief Parses the given columns of a csv record into a row of the table.
+ *
+ * The record is walked field by field with csv_next_field, so quoted fields
+ * may hold commas; fields whose column is not requested are skipped without
+ * being converted, and the walk stops after the last requested field.
+ * String fields are unquoted into new allocations.
+ *
+ * @param line The csv line of the row.
+ * @param table The table to store the fields in.
+ * @param row The row to store the fields in.
+ * @param columns The COL_* flags of the fields to parse.
+ */
+void parse_line_to_columns(const char *line, song_table *table, int row, unsigned int columns)
+{
+    const char *p = line;
+    for (int field = 0; p != NULL && field < COL_NUMBER_OF_FIELDS && (columns >> field) != 0; field++)
+    {
+        csv_field f;
+        const char *next = csv_next_field(p, &f);
+        if (f.error != NULL)
+        {
+            // the reader only lets well-formed records through
+            break;
+        }
+
+        if (columns & (1u << field))
+        {
+            long int value = 0;
+            if (field > 1)
+            {
+                parse_number(f.start, &value);
+            }
+            switch (1u << field)
+            {
+            case COL_TRACK_NAME:
+                free(table->track_name[row]);
+                table->track_name[row] = csv_field_dup(&f);
+                break;
+            case COL_ARTISTS_NAME:
+                free(table->artists_name[row]);
+                table->artists_name[row] = csv_field_dup(&f);
+                break;
+            case COL_ARTIST_COUNT:
+                table->artist_count[row] = (int)value;
+                break;
+            case COL_RELEASED_YEAR:
+                table->released_year[row] = (int)value;
+                break;
+            case COL_RELEASED_MONTH:
+                table->released_month[row] = (int)value;
+                break;
+            case COL_RELEASED_DAY:
+                table->released_day[row] = (int)value;
+                break;
+            case COL_SPOTIFY_PLAYLISTS:
+                table->in_spotify_playlists[row] = (int)value;
+                break;
+            case COL_STREAMS:
+                table->streams[row] = value;
+                break;
+            case COL_APPLE_PLAYLISTS:
+                table->in_apple_playlists[row] = (int)value;
+                break;
+            }
+        }
+        p = next;
+    }
+}
+
+/**
+ * @brief Returns the artists field of a csv line.
+ */
+static csv_field artists_field(const char *line)
+{
+    csv_field f;
+    const char *p = csv_next_field(line, &f);
+    if (p == NULL)
+    {
+        f.start = "";
+        f.length = 0;
+        f.quoted = 0;
+        f.error = NULL;
+        return f;
+    }
+    csv_next_field(p, &f);
+    return f;
+}
+
+/**
+ * @brief Parses the artist names of all the rows of a table straight into one buffer.
+ *
+ * The first pass sizes the buffer, so each name is copied exactly once and
+ * no per-row string is ever allocated (freeing a million small strings
+ * costs more than the scan the buffer speeds up).
+ *
+ * @param table The table, whose lines are set.
+ */
+static void parse_packed_artists(song_table *table)
+{
+    size_t size = 0;
+    for (int i = 0; i < table->rows; i++)
+    {
+        size += artists_field(table->lines[i]).length + 1;
+    }
+    char *buffer = (char *)emalloc(size > 0 ? size : 1);
+    size_t offset = 0;
+    for (int i = 0; i < table->rows; i++)
+    {
+        csv_field f = artists_field(table->lines[i]);
+        table->artists_name[i] = buffer + offset;
+        offset += csv_field_copy(&f, buffer + offset) + 1;
+    }
+    table->artists_buffer = buffer;
+    table->artists_buffer_size = offset;
+    table->artists_buffer_owned = 1;
+}
+
+/**
+ * @brief Builds a song table from a linked list of csv lines, parsing only the given columns.
+ *
+ * The table takes ownership of the line strings and frees the nodes of the
+ * list, so `lines` must not be used afterwards. Columns that are not parsed
+ * here can be parsed later for selected rows with table_materialize.
+ *
+ * @param lines The head of the linked list of lines (without the header).
+ * @param columns The COL_* flags of the columns to parse for every row.
+ * @return song_table* A pointer to the new table.
+ */
+song_table *table_from_list(node_t *lines, unsigned int columns)
+{
+    int rows = 0;
+    apply(lines, inccounter, &rows);
+    song_table *table = new_table(rows);
+    table->columns = columns;
+    table->lines = (char **)emalloc((rows > 0 ? rows : 1) * sizeof(char *));
+
+    int i = 0;
+    node_t *current = lines;
+    while (current != NULL)
+    {
+        table->lines[i] = current->word;
+        parse_line_to_columns(current->word, table, i, columns & ~COL_ARTISTS_NAME);
+
+        node_t *next = current->next;
+        free(current);
+        current = next;
+        i++;
+    }
+
+    if (columns & COL_ARTISTS_NAME)
+    {
+        parse_packed_artists(table);
+    }
+    return table;
+}
+
+/**
+ * @brief Parses the given columns for the given rows, if the table does not already have them.
+ *
+ * Used to decode the output-only columns (e.g. the names) just for the rows
+ * that are written.
+ *
+ * @param table The table.
+ * @param columns The COL_* flags of the columns needed.
+ * @param rows The rows that need them.
+ * @param count The number of rows.
+ */
+void table_materialize(song_table *table, unsigned int columns, const int *rows, int count)
+{
+    unsigned int missing = columns & ~table->columns;
+    if (missing == 0 || table->lines == NULL)
+    {
+        return;
+    }
+    for (int i = 0; i < count; i++)
+    {
+        parse_line_to_columns(table->lines[rows[i]], table, rows[i], missing);
+    }
+}
+
+/**
+ * @brief Stores the artist names of a table one after another in a single buffer.
+ *
+ * Names that already lie one after another in the table's heap (as a
+ * column file stores them) are used in place; otherwise they are copied
+ * into a new buffer, and `artists_name` is pointed into it. Does nothing if
+ * the table is packed already or some name is not loaded.
+ *
+ * @param table The table.
+ */
+void table_pack_artists(song_table *table)
+{
+    if (table->artists_buffer != NULL || table->rows == 0)
+    {
+        return;
+    }
+    size_t size = 0;
+    int in_place = table->heap != NULL;
+    for (int i = 0; i < table->rows; i++)
+    {
+        if (table->artists_name[i] == NULL)
+        {
+            return;
+        }
+        in_place &= table->artists_name[i] == table->artists_name[0] + size;
+        size += strlen(table->artists_name[i]) + 1;
+    }
+
+    table->artists_buffer_size = size;
+    if (in_place)
+    {
+        table->artists_buffer = table->artists_name[0];
+        return;
+    }
+    char *buffer = (char *)emalloc(size);
+    size_t offset = 0;
+    for (int i = 0; i < table->rows; i++)
+    {
+        size_t length = strlen(table->artists_name[i]) + 1;
+        memcpy(buffer + offset, table->artists_name[i], length);
+        if (table->heap == NULL)
+        {
+            free(table->artists_name[i]);
+        }
+        table->artists_name[i] = buffer + offset;
+        offset += length;
+    }
+    table->artists_buffer = buffer;
+    table->artists_buffer_owned = 1;
+}
+
+/**
+ * @brief Frees the memory allocated for a song table, including its lines and strings.
+ *
+ * @param table The table to free.
+ */
+void free_table(song_table *table)
+{
+    if (table == NULL)
+    {
+        return;
+    }
+    if (table->lines != NULL)
+    {
+        for (int i = 0; i < table->rows; i++)
+        {
+            free(table->lines[i]);
+        }
+        free(table->lines);
+    }
+    if (table->heap != NULL)
+    {
+        free(table->heap);
+    }
+    else
+    {
+        for (int i = 0; i < table->rows; i++)
+        {
+            free(table->track_name[i]);
+            if (table->artists_buffer == NULL)
+            {
+                free(table->artists_name[i]);
+            }
+        }
+    }
+    if (table->artists_buffer_owned)
+    {
+        free(table->artists_buffer);
+    }
+    free(table->zones);
+    free(table->track_name);
+    free(table->artists_name);
+    free(table->artist_count);
+    free(table->released_year);
+    free(table->released_month);
+    free(table->released_day);
+    free(table->in_spotify_playlists);
+    free(table->streams);
+    free(table->in_apple_playlists);
+    free(table);
+}
@@ -0,0 +1,82 @@
+/** @file table.h
+ *  @brief Function prototypes for the column-oriented song table.
+ *
+ * The table keeps every field of the songs in its own contiguous array
+ * (one entry per row), so that filters can scan a single column instead
+ * of re-parsing each line.
+ */
+#ifndef _TABLE_H_
+#define _TABLE_H_
+
+#include "list.h"
+
+/**
+ * @brief Bit flags naming the columns of a song table, in csv field order.
+ */
+#define COL_TRACK_NAME (1u << 0)
+#define COL_ARTISTS_NAME (1u << 1)
+#define COL_ARTIST_COUNT (1u << 2)
+#define COL_RELEASED_YEAR (1u << 3)
+#define COL_RELEASED_MONTH (1u << 4)
+#define COL_RELEASED_DAY (1u << 5)
+#define COL_SPOTIFY_PLAYLISTS (1u << 6)
+#define COL_STREAMS (1u << 7)
+#define COL_APPLE_PLAYLISTS (1u << 8)
+#define COL_ALL 0x1ffu
+#define COL_NUMBER_OF_FIELDS 9
+
+/**
+ * @brief The columns write_rows_to_file needs besides the "--order_by" field.
+ */
+#define COL_OUTPUT (COL_TRACK_NAME | COL_ARTISTS_NAME | COL_RELEASED_YEAR | COL_RELEASED_MONTH | COL_RELEASED_DAY)
+
+/**
+ * @brief An struct that represents the songs of a data file column by column.
+ *
+ * Row `i` of a table loaded from csv is the song held in `lines[i]`. Only the
+ * columns in `columns` are parsed for every row; the others are parsed on
+ * demand for the rows that need them (see table_materialize), and until then
+ * their strings are NULL. Tables loaded from binary files have every column,
+ * no lines (NULL), and keep all their strings in the single allocation `heap`.
+ * Tables loaded from column files also have the zone maps of their blocks
+ * (see zonemap.h), which let filter_table skip blocks; other tables have none.
+ *
+ * When table_from_list parses the artist names, or table_pack_artists has
+ * run, the names are stored one after another in `artists_buffer`, each followed by its NUL, and
+ * `artists_name[i]` points into it; the ARTIST filter scans the buffer in
+ * one pass. The buffer is freed with the table if `artists_buffer_owned`.
+ */
+typedef struct
+{
+    int rows;
+    unsigned int columns;
+    char **lines;
+    char *heap;
+    char **track_name;
+    char **artists_name;
+    int *artist_count;
+    int *released_year;
+    int *released_month;
+    int *released_day;
+    int *in_spotify_playlists;
+    long int *streams;
+    int *in_apple_playlists;
+    struct zone_map *zones;
+    int zone_count;
+    char *artists_buffer;
+    size_t artists_buffer_size;
+    int artists_buffer_owned;
+} song_table;
+
+/**
+ * Function protypes associated with the song table.
+ *
+ */
+song_table *new_table(int rows);
+song_table *table_from_list(node_t *lines, unsigned int columns);
+void parse_line_to_columns(const char *line, song_table *table, int row, unsigned int columns);
+void table_materialize(song_table *table, unsigned int columns, const int *rows, int count);
+void table_pack_artists(song_table *table);
+void free_table(song_table *table);
+
+#endif
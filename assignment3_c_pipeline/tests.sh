@@ -0,0 +1,226 @@
+#!/bin/bash
+#
+# tests.sh - regression checks for song_analyzer.
+#
+# Usage:
+#   ./tests.sh [BINARY]        run every check against BINARY (default
+#                              ./song_analyzer) and report the failures
+#
+# Each check runs the program on data.csv or on a small file written to a
+# temporary directory, and compares its exit status, messages or output
+# with what is expected. The exit status is the number of failed checks.
+#
+BIN=${1:-./song_analyzer}
+TMP=$(mktemp -d)
+trap 'rm -rf "$TMP"' EXIT
+FAILED=0
+
+# Reports a check as passed or failed.
+#   $1  the name of the check
+#   $2  0 if it passed
+report()
+{
+    if [ "$2" = 0 ]; then
+        echo "ok   $1"
+    else
+        echo "FAIL $1"
+        FAILED=$((FAILED + 1))
+    fi
+}
+
+# --order_by takes at most 8 keys; a longer list is an error, not an overflow.
+check_order_by_keys()
+{
+    local nine eight
+    nine=$(printf 'YEAR,%.0s' {1..9})
+    eight=$(printf 'YEAR,%.0s' {1..8})
+    "$BIN" --data=data.csv --order_by="${nine%,}" 2> "$TMP/err" > /dev/null
+    [ $? = 1 ] && grep -q "more than 8 keys" "$TMP/err"
+    report "9-key --order_by is rejected" $?
+    "$BIN" --data=data.csv --order_by="${eight%,}" --limit=1 > /dev/null 2>&1
+    report "8-key --order_by is accepted" $?
+    if [ -f libsong_analyzer.so ]; then
+        python3 -c "
+import songlib
+try:
+    songlib.Dataset('data.csv').query(order_by=','.join(['YEAR'] * 9))
+except songlib.SongLibError as error:
+    exit('more than 8 keys' not in str(error))
+exit(1)" 2> /dev/null
+        report "9-key order_by is rejected by the library" $?
+    fi
+}
+
+# A stray quote in an unquoted field rejects its own row only; a quoted
+# field may still span lines.
+check_stray_quote()
+{
+    local csv="$TMP/stray.csv"
+    head -200 data.csv > "$csv"
+    sed -i '51s/^[^,]*/Don"t Stop/' "$csv"
+    printf '"Two\nLines",Someone,1,2020,1,1,10,100,1\n' >> "$csv"
+    "$BIN" --data="$csv" --stats > /dev/null 2> "$TMP/err"
+    grep -q "^rows loaded: 199$" "$TMP/err" && grep -q "^rows rejected: 1$" "$TMP/err"
+    report "a stray quote rejects only its row" $?
+    grep -q "^Lines\",Someone$" output.csv
+    report "a quoted field spans lines" $?
+}
+
+# --pipeline writes what the in-memory path writes, whether --threads leaves
+# it enough threads or it falls back to the in-memory path.
+check_pipeline_threads()
+{
+    local t ok=0
+    "$BIN" --data=data.csv --filter=YEAR --value=2022 --threads=1 > /dev/null 2>&1
+    cp output.csv "$TMP/expected.csv"
+    for t in 1 2 4 8; do
+        "$BIN" --data=data.csv --filter=YEAR --value=2022 --pipeline --threads=$t > /dev/null 2>&1 &&
+            cmp -s output.csv "$TMP/expected.csv" || ok=1
+    done
+    report "--pipeline output does not depend on --threads" $ok
+}
+
+# An output file that cannot be created is reported, on every output path.
+check_unwritable_output()
+{
+    local dir="$TMP/unwritable" bin
+    bin=$(readlink -f "$BIN")
+    mkdir -p "$dir/output.csv"
+    cp data.csv "$dir"
+    (cd "$dir" && "$bin" --group_by=YEAR 2> err > /dev/null; [ $? = 1 ] && grep -q "^output.csv: " err)
+    report "--group_by reports an output file it cannot open" $?
+    for approx in DISTINCT TOP:STREAMS; do
+        (cd "$dir" && "$bin" --approx=$approx 2> err > /dev/null; [ $? = 1 ] && grep -q "^output.csv: " err)
+        report "--approx=$approx reports an output file it cannot open" $?
+    done
+}
+
+# A sample that holds every row is ordered like the row query, by any
+# --order_by list.
+check_sample_order()
+{
+    local list order ok=0
+    for list in YEAR STREAMS,YEAR "YEAR:DES,STREAMS:DES,TRACK_NAME"; do
+        for order in ASC DES; do
+            "$BIN" --data=data.csv --order_by="$list" --order=$order > /dev/null 2>&1
+            cp output.csv "$TMP/expected.csv"
+            "$BIN" --data=data.csv --approx=SAMPLE --limit=100000 --order_by="$list" --order=$order > /dev/null 2>&1 &&
+                cmp -s output.csv "$TMP/expected.csv" || ok=1
+        done
+    done
+    report "--approx=SAMPLE orders by an --order_by list" $ok
+}
+
+# --partition converts every row, so it refuses the options of a query
+# instead of ignoring them.
+check_partition_options()
+{
+    "$BIN" --data=data.csv --filter=YEAR --value=2022 --limit=3 --partition="$TMP/parts" 2> "$TMP/err" > /dev/null
+    [ $? = 1 ] && grep -q "cannot be combined with --filter" "$TMP/err" && [ ! -e "$TMP/parts" ]
+    report "--partition rejects --filter" $?
+    "$BIN" --data=data.csv --partition="$TMP/parts" > /dev/null 2>&1 && [ -n "$(ls "$TMP/parts")" ]
+    report "--partition alone converts the data" $?
+}
+
+# Writes $2 copies of data.csv to $1 as one file, the track names of each
+# copy prefixed with its number, so every STREAMS value is tied across the
+# copies while the rows stay distinguishable.
+write_copies()
+{
+    local k
+    head -1 data.csv > "$1"
+    for k in $(seq 1 "$2"); do
+        # data.csv has no final newline; the blank lines this leaves are skipped
+        sed -e 1d -e "s/^\"/\"$k /" -e t -e "s/^/$k /" data.csv
+        echo
+    done >> "$1"
+}
+
+# --memory-limit spills sorted runs and merges them, and must give the
+# output of the in-memory path, ties and limits included.
+check_memory_limit()
+{
+    local csv="$TMP/copies.csv" query ok=0
+    write_copies "$csv" 80
+    for query in "--order_by=STREAMS" "--order_by=STREAMS --order=DES" \
+                 "--order_by=STREAMS --order=DES --limit=25" "--filter=YEAR --value=2022 --order_by=STREAMS --limit=1000"; do
+        "$BIN" --data="$csv" $query > /dev/null 2>&1
+        cp output.csv "$TMP/expected.csv"
+        "$BIN" --data="$csv" $query --memory-limit=2M --stats > /dev/null 2> "$TMP/err" &&
+            grep -q "^runs spilled: [1-9]" "$TMP/err" && cmp -s output.csv "$TMP/expected.csv" || ok=1
+    done
+    report "--memory-limit matches the in-memory path" $ok
+    "$BIN" --data=data.csv --memory-limit=1M --order_by=STREAMS 2> "$TMP/err" > /dev/null
+    [ $? = 1 ] && grep -q "at least 2M" "$TMP/err"
+    report "--memory-limit below 2M is rejected" $?
+}
+
+# data.csv split into two files and queried as one dataset gives the output
+# of the single file, ties across the files included.
+check_shards()
+{
+    local query ok=0
+    head -1 data.csv > "$TMP/shard_1.csv"
+    sed -n '2,400p' data.csv >> "$TMP/shard_1.csv"
+    head -1 data.csv > "$TMP/shard_2.csv"
+    sed -n '401,$p' data.csv >> "$TMP/shard_2.csv"
+    for query in "" "--limit=500" "--order_by=STREAMS" "--order_by=STREAMS --order=DES" "--order_by=YEAR" \
+                 "--order_by=YEAR --order=DES --limit=300" "--order_by=YEAR:DES,STREAMS:DES,TRACK_NAME --limit=50" \
+                 "--filter=YEAR --value=2022 --order_by=NO_SPOTIFY_PLAYLISTS --limit=7"; do
+        "$BIN" --data=data.csv $query > /dev/null 2>&1
+        cp output.csv "$TMP/expected.csv"
+        "$BIN" --data="$TMP/shard_1.csv,$TMP/shard_2.csv" $query > /dev/null 2>&1 &&
+            cmp -s output.csv "$TMP/expected.csv" || ok=1
+        "$BIN" --data="$TMP/shard_*.csv" $query > /dev/null 2>&1 && cmp -s output.csv "$TMP/expected.csv" || ok=1
+    done
+    report "several --data files match the single file" $ok
+}
+
+# Follows the --after cursors of a query page by page and writes the rows of
+# the pages, without their headers, to $TMP/pages.csv.
+#   $1  the number of rows of a page
+#   $@  the rest: the query
+read_pages()
+{
+    local limit=$1 cursor="" pages=0 rows
+    shift
+    : > "$TMP/pages.csv"
+    while [ $pages -lt 1000 ]; do
+        cursor=$("$BIN" --data=data.csv "$@" --after="$cursor" --limit=$limit 2> /dev/null) || return 1
+        tail -n +2 output.csv >> "$TMP/pages.csv"
+        rows=$(($(wc -l < output.csv) - 1))
+        pages=$((pages + 1))
+        # a short page is the last; after a full last page comes an empty one
+        [ $rows -lt $limit ] && return 0
+    done
+    return 1
+}
+
+# The pages of --after, put together, are the whole sorted result: with a
+# single key, with ties across pages, with a list of keys, and with a row
+# count that is a multiple of the page size.
+check_pagination()
+{
+    local page query ok=0
+    for page in "50 --order_by=STREAMS" "50 --order_by=STREAMS --order=DES" "40 --order_by=YEAR" \
+                "7 --order_by=YEAR:DES,STREAMS:DES,TRACK_NAME" "67 --filter=YEAR --value=2022 --order_by=STREAMS"; do
+        query=${page#* }
+        "$BIN" --data=data.csv $query > /dev/null 2>&1
+        tail -n +2 output.csv > "$TMP/expected.csv"
+        read_pages ${page%% *} $query && cmp -s "$TMP/pages.csv" "$TMP/expected.csv" || ok=1
+    done
+    report "--after pages add up to the sorted result" $ok
+}
+
+check_order_by_keys
+check_stray_quote
+check_pipeline_threads
+check_unwritable_output
+check_sample_order
+check_partition_options
+check_memory_limit
+check_shards
+check_pagination
+
+echo "$FAILED failed"
+exit $FAILED
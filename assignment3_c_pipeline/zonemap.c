@@ -0,0 +1,174 @@
+/** @file zonemap.c
+ *  @brief Implementation of zonemap.h
+ *
+ */
+#include <stdlib.h>
+#include <string.h>
+#include "scan.h"
+#include "table.h"
+#include "zonemap.h"
+
+/**
+ * @brief Returns the number of blocks, and so of zone maps, of `rows` rows.
+ *
+ * @param rows The number of rows.
+ * @return int The number of blocks.
+ */
+int zone_count(int rows)
+{
+    return (rows + ZONE_BLOCK_ROWS - 1) / ZONE_BLOCK_ROWS;
+}
+
+/**
+ * @brief Returns the two bloom filter bits of a trigram.
+ */
+static void trigram_bits(const char *s, uint32_t *a, uint32_t *b)
+{
+    uint32_t trigram = (uint32_t)(unsigned char)s[0] | (uint32_t)(unsigned char)s[1] << 8 |
+                       (uint32_t)(unsigned char)s[2] << 16;
+    *a = (trigram * 0x9e3779b1u) % ZONE_BLOOM_BITS;
+    *b = (trigram * 0x85ebca77u >> 7) % ZONE_BLOOM_BITS;
+}
+
+/**
+ * @brief Adds every trigram of a string to a bloom filter.
+ */
+static void bloom_add(uint64_t *bloom, const char *s)
+{
+    size_t n = strlen(s);
+    for (size_t i = 0; i + 3 <= n; i++)
+    {
+        uint32_t a, b;
+        trigram_bits(s + i, &a, &b);
+        bloom[a / 64] |= 1ull << (a % 64);
+        bloom[b / 64] |= 1ull << (b % 64);
+    }
+}
+
+/**
+ * @brief Tells whether every trigram of a string may be in a bloom filter.
+ *
+ * Strings shorter than a trigram always may be.
+ */
+static int bloom_may_contain(const uint64_t *bloom, const char *s)
+{
+    size_t n = strlen(s);
+    for (size_t i = 0; i + 3 <= n; i++)
+    {
+        uint32_t a, b;
+        trigram_bits(s + i, &a, &b);
+        if (!(bloom[a / 64] >> (a % 64) & 1) || !(bloom[b / 64] >> (b % 64) & 1))
+        {
+            return 0;
+        }
+    }
+    return 1;
+}
+
+/**
+ * @brief Computes the zone maps of the given rows of a table, as they are written to a column file.
+ *
+ * @param table The table the rows belong to; must have every column.
+ * @param rows The row ids, in file order.
+ * @param count The number of row ids.
+ * @param zones The zone_count(count) zone maps to fill.
+ */
+void build_zone_maps(const song_table *table, const int *rows, int count, zone_map *zones)
+{
+    for (int z = 0; z < zone_count(count); z++)
+    {
+        zone_map *zone = &zones[z];
+        memset(zone, 0, sizeof(*zone));
+        zone->first_row = z * ZONE_BLOCK_ROWS;
+        zone->rows = count - zone->first_row < ZONE_BLOCK_ROWS ? count - zone->first_row : ZONE_BLOCK_ROWS;
+        for (int i = zone->first_row; i < zone->first_row + zone->rows; i++)
+        {
+            int row = rows[i];
+            int first = i == zone->first_row;
+            int year = table->released_year[row];
+            int spotify = table->in_spotify_playlists[row];
+            int apple = table->in_apple_playlists[row];
+            long int streams = table->streams[row];
+            zone->min_year = first || year < zone->min_year ? year : zone->min_year;
+            zone->max_year = first || year > zone->max_year ? year : zone->max_year;
+            zone->min_spotify_playlists =
+                first || spotify < zone->min_spotify_playlists ? spotify : zone->min_spotify_playlists;
+            zone->max_spotify_playlists =
+                first || spotify > zone->max_spotify_playlists ? spotify : zone->max_spotify_playlists;
+            zone->min_apple_playlists = first || apple < zone->min_apple_playlists ? apple : zone->min_apple_playlists;
+            zone->max_apple_playlists = first || apple > zone->max_apple_playlists ? apple : zone->max_apple_playlists;
+            zone->min_streams = first || streams < zone->min_streams ? streams : zone->min_streams;
+            zone->max_streams = first || streams > zone->max_streams ? streams : zone->max_streams;
+            bloom_add(zone->artist_trigrams, table->artists_name[row]);
+        }
+    }
+}
+
+/**
+ * @brief Tells whether a single predicate may hold for some row of a block.
+ */
+static int predicate_may_match(const zone_map *zone, const predicate *p)
+{
+    if (strcmp(p->name, "ARTIST") == 0)
+    {
+        return bloom_may_contain(zone->artist_trigrams, p->value);
+    }
+    if (strcmp(p->name, "YEAR") == 0)
+    {
+        int year = atoi(p->value);
+        return zone->min_year <= year && year <= zone->max_year;
+    }
+    if (strcmp(p->name, "MIN_YEAR") == 0)
+    {
+        return zone->max_year >= atoi(p->value);
+    }
+    if (strcmp(p->name, "MAX_YEAR") == 0)
+    {
+        return zone->min_year <= atoi(p->value);
+    }
+    if (strcmp(p->name, "MIN_STREAMS") == 0)
+    {
+        return zone->max_streams >= atol(p->value);
+    }
+    if (strcmp(p->name, "MIN_SPOTIFY_PLAYLISTS") == 0)
+    {
+        return zone->max_spotify_playlists >= atoi(p->value);
+    }
+    if (strcmp(p->name, "MIN_APPLE_PLAYLISTS") == 0)
+    {
+        return zone->max_apple_playlists >= atoi(p->value);
+    }
+    // unknown filters are reported by the scan
+    return 1;
+}
+
+/**
+ * @brief Tells whether some row of a block may satisfy a filter.
+ *
+ * @param zone The zone map of the block.
+ * @param expr The filter; NULL matches every row.
+ * @return int 0 if no row of the block can be selected, 1 otherwise.
+ */
+int zone_may_match(const zone_map *zone, const filter_expr *expr)
+{
+    if (expr == NULL)
+    {
+        return 1;
+    }
+
+    int i = 0;
+    while (i < expr->count)
+    {
+        int group = expr->predicates[i].group;
+        int possible = 1;
+        for (; i < expr->count && expr->predicates[i].group == group; i++)
+        {
+            possible = possible && predicate_may_match(zone, &expr->predicates[i]);
+        }
+        if (possible)
+        {
+            return 1;
+        }
+    }
+    return 0;
+}
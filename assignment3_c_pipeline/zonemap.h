@@ -0,0 +1,58 @@
+/** @file zonemap.h
+ *  @brief Function prototypes for the per-block statistics (zone maps) of column files.
+ *
+ * A column file splits its rows into blocks of ZONE_BLOCK_ROWS rows and
+ * stores, for every block, the range of each numeric column a filter can
+ * test and a bloom filter of the trigrams (3-byte substrings) of its artist
+ * names. The filter stage skips a block when its zone map shows that no
+ * row in it can satisfy the filter.
+ */
+#ifndef _ZONEMAP_H_
+#define _ZONEMAP_H_
+
+#include <stdint.h>
+#include "scan.h"
+#include "table.h"
+
+/**
+ * @brief The number of rows summarized by one zone map.
+ */
+#define ZONE_BLOCK_ROWS 65536
+
+/**
+ * @brief The size in bits of the artist trigram bloom filter of a block.
+ */
+#define ZONE_BLOOM_BITS 16384
+
+#define ZONE_BLOOM_WORDS (ZONE_BLOOM_BITS / 64)
+
+/**
+ * @brief An struct that represents the statistics of one block of rows.
+ *
+ * It is stored as is in column files, where `first_row` is relative to the
+ * file; once loaded it is relative to the table.
+ */
+typedef struct zone_map
+{
+    int32_t first_row;
+    int32_t rows;
+    int32_t min_year;
+    int32_t max_year;
+    int32_t min_spotify_playlists;
+    int32_t max_spotify_playlists;
+    int32_t min_apple_playlists;
+    int32_t max_apple_playlists;
+    int64_t min_streams;
+    int64_t max_streams;
+    uint64_t artist_trigrams[ZONE_BLOOM_WORDS];
+} zone_map;
+
+/**
+ * Function protypes associated with the zone maps.
+ *
+ */
+int zone_count(int rows);
+void build_zone_maps(const song_table *table, const int *rows, int count, zone_map *zones);
+int zone_may_match(const zone_map *zone, const filter_expr *expr);
+
+#endif